@@ -1,1040 +1,5425 @@
-#include <SFML/Graphics.hpp>
-#include <SFML/Audio.hpp>
-#include <vector>
-#include <iostream>
-#include <fstream>
-#include <algorithm>
-#include <string>
-#include <random>
-#include <memory>
-
-// --- Game Configuration Struct ---
-
-struct GameConfig {
-    static constexpr int PLAYER_MAX_HEALTH = 100;
-
-    static constexpr int BOSS_MAX_HEALTH = 120;
-
-    static constexpr int ENEMY_DAMAGE_LEVEL1 = 10;
-    static constexpr int ENEMY_DAMAGE_LEVEL2 = 20;
-    static constexpr int ENEMY_DAMAGE_DEFAULT = 20;
-
-    static constexpr int BOSS_BULLET_DAMAGE = 30;
-
-    static constexpr float ENEMY_SPEED_LEVEL1 = 0.25f;
-    static constexpr float ENEMY_SPEED_LEVEL2 = 0.33f;
-    static constexpr float ENEMY_SPAWN_RATE_LEVEL1 = 1.5f;
-    static constexpr float ENEMY_SPAWN_RATE_LEVEL2 = 1.1f;
-    static constexpr float ENEMY_SPAWN_RATE_DEFAULT = 1000.f;
-
-    static constexpr int LEVEL2_SCORE_THRESHOLD = 80;
-    static constexpr int LEVEL3_SCORE_THRESHOLD = 140;
-    static constexpr int LEVEL2_MAX_ENEMIES = 4;
-    static constexpr int LEVEL2_DOUBLE_SPAWN_FREQ = 5;
-    static constexpr float LEVEL2_DOUBLE_SPAWN_SPEED_BONUS = 0.03f;
-
-    static constexpr float BOSS_MOVE_SPEED = 0.5f;
-    static constexpr float BOSS_DESCEND_Y = 100.f;
-    static constexpr float BOSS_DESCEND_SPEED = 0.2f;
-    static constexpr float BOSS_BULLET_SPEED = 0.5f;
-    static constexpr float BOSS_BULLET_SPEED_PHASE2 = 1.0f;
-    static constexpr float BOSS_BULLET_SPEED_PHASE3 = 1.2f;
-    static constexpr float BOSS_ATTACK_INTERVAL = 1.f;
-    static constexpr float BOSS_ATTACK_INTERVAL_PHASE2 = 0.7f;
-    static constexpr float BOSS_ATTACK_INTERVAL_PHASE3 = 0.5f;
-    static constexpr int BOSS_BULLET_DAMAGE_AMOUNT = 30;
-    static constexpr int BOSS_HIT_DAMAGE = 10;
-    static constexpr int BOSS_PHASE2_HP = 80;
-    static constexpr int BOSS_PHASE3_HP = 50;
-    static constexpr float BOSS_SPREAD_BULLET_INTERVAL = 3.0f;
-    static constexpr float BOSS_MINION_SPAWN_INTERVAL = 3.0f;
-    static constexpr int BOSS_SPREAD_BULLET_COUNT = 4;
-    static constexpr float BOSS_SPREAD_BULLET_ANGLE = 40.f;
-
-    static constexpr float BULLET_ANIMATION_INTERVAL_MS = 40.f;
-    static constexpr float BULLET_MOVE_SPEED = -1.f;
-    static constexpr int BULLET_OFFSCREEN_Y = 0;
-
-    static constexpr float EXPLOSION_ANIMATION_INTERVAL_MS = 80.f;
-    static constexpr int EXPLOSION_FRAMES = 8;
-
-    static constexpr float HEALTH_BAR_WIDTH = 200.f;
-    static constexpr float HEALTH_BAR_HEIGHT = 20.f;
-    static constexpr float SHAKE_INTENSITY = 10.f;
-    static constexpr float SHAKE_DURATION = 0.3f;
-
-    static constexpr int WINDOW_WIDTH = 800;
-    static constexpr int WINDOW_HEIGHT = 600;
-
-    // Powerup config
-    static constexpr float HEALTH_POWERUP_SPEED = 0.25f;
-    static constexpr float HEALTH_POWERUP_SPAWN_MIN = 8.0f; // seconds
-    static constexpr float HEALTH_POWERUP_SPAWN_MAX = 15.0f; // seconds
-    static constexpr int HEALTH_POWERUP_AMOUNT = 50;
-    static constexpr int HEALTH_POWERUP_MAX = 100;
-};
-
-// Helper functions 
-std::vector<int> readScoresFromFile(const std::string& filename) {
-    std::vector<int> scores;
-    std::ifstream infile(filename);
-    int s;
-    while (infile >> s) {
-        scores.push_back(s);
-    }
-    return scores;
-}
-void appendScoreToFile(const std::string& filename, int score) {
-    std::ofstream outfile(filename, std::ios::app);
-    if (outfile.is_open()) {
-        outfile << score << std::endl;
-    }
-}
-int getHighScore(const std::string& filename) {
-    std::vector<int> scores = readScoresFromFile(filename);
-    if (!scores.empty()) {
-        return *std::max_element(scores.begin(), scores.end());
-    }
-    return 0;
-}
-
-// --- Game Entities  ---
-class Bullet {
-public:
-    std::vector<sf::Texture> frames;
-    sf::Sprite sprite;
-    int currentFrame = 0;
-    sf::Clock frameClock;
-    sf::Vector2f velocity = { 0.f, GameConfig::BULLET_MOVE_SPEED };
-    Bullet(const std::vector<sf::Texture>& bulletFrames, sf::Vector2f position) {
-        frames = bulletFrames;
-        sprite.setTexture(frames[0]);
-        sprite.setPosition(position);
-    }
-    Bullet(const std::vector<sf::Texture>& bulletFrames, sf::Vector2f position, sf::Vector2f vel) {
-        frames = bulletFrames;
-        sprite.setTexture(frames[0]);
-        sprite.setPosition(position);
-        velocity = vel;
-    }
-    void update() {
-        if (frameClock.getElapsedTime().asMilliseconds() > GameConfig::BULLET_ANIMATION_INTERVAL_MS) {
-            currentFrame = (currentFrame + 1) % frames.size();
-            sprite.setTexture(frames[currentFrame]);
-            frameClock.restart();
-        }
-        sprite.move(velocity);
-    }
-};
-
-class Enemy {
-public:
-    sf::Sprite sprite;
-    float speed;
-    Enemy(sf::Texture& texture, sf::Vector2f position) {
-        sprite.setTexture(texture);
-        sprite.setPosition(position);
-        speed = GameConfig::ENEMY_SPEED_LEVEL1;
-    }
-    virtual void update() { sprite.move(0.f, speed); }
-    virtual ~Enemy() {}
-};
-
-class AnimatedEnemy : public Enemy {
-public:
-    std::vector<sf::Texture> frames;
-    int currentFrame = 0;
-    sf::Clock frameClock;
-    AnimatedEnemy(const std::vector<sf::Texture>& enemyFrames, sf::Vector2f position, float spd)
-        : Enemy(const_cast<sf::Texture&>(enemyFrames[0]), position), frames(enemyFrames) {
-        speed = spd;
-        sprite.setTexture(frames[0]);
-    }
-    void update() override {
-        if (frameClock.getElapsedTime().asMilliseconds() > 100) {
-            currentFrame = (currentFrame + 1) % frames.size();
-            sprite.setTexture(frames[currentFrame]);
-            frameClock.restart();
-        }
-        sprite.move(0.f, speed);
-    }
-};
-
-class Explosion {
-public:
-    std::vector<sf::Texture> frames;
-    sf::Sprite sprite;
-    int currentFrame = 0;
-    sf::Clock frameClock;
-    bool finished = false;
-    Explosion(const sf::Vector2f& position) {
-        for (int i = 0; i < GameConfig::EXPLOSION_FRAMES; ++i) {
-            sf::Texture tex;
-            tex.loadFromFile("D:/OOP Project/Space Invaders/Space Invaders/assets/explotion/sprite_" + std::to_string(i) + ".png");
-            frames.push_back(tex);
-        }
-        sprite.setTexture(frames[0]);
-        sprite.setPosition(position);
-    }
-    void update() {
-        if (frameClock.getElapsedTime().asMilliseconds() > GameConfig::EXPLOSION_ANIMATION_INTERVAL_MS) {
-            currentFrame++;
-            if (currentFrame < frames.size()) {
-                sprite.setTexture(frames[currentFrame]);
-                frameClock.restart();
-            }
-            else {
-                finished = true;
-            }
-        }
-    }
-};
-
-class Boss {
-public:
-    std::vector<sf::Texture> frames;
-    sf::Sprite sprite;
-    int currentFrame = 0;
-    sf::Clock animationClock;
-    float moveSpeed = GameConfig::BOSS_MOVE_SPEED;
-    int direction = 1;
-    int health = GameConfig::BOSS_MAX_HEALTH;
-    enum Phase { PHASE1, PHASE2, PHASE3 };
-    Phase phase = PHASE1;
-    Boss() {
-        for (int i = 0; i < 6; ++i) {
-            sf::Texture tex;
-            tex.loadFromFile("D:/OOP Project/Space Invaders/Space Invaders/assets/final_boss_animation/sprite_" + std::to_string(i) + ".png");
-            frames.push_back(tex);
-        }
-        sprite.setTexture(frames[0]);
-        sprite.setPosition(300.f, -100.f);
-    }
-    void update() {
-        if (animationClock.getElapsedTime().asMilliseconds() > 100) {
-            currentFrame = (currentFrame + 1) % frames.size();
-            sprite.setTexture(frames[currentFrame]);
-            animationClock.restart();
-        }
-        sprite.move(moveSpeed * direction, 0.f);
-        if (sprite.getPosition().x <= 0 || sprite.getPosition().x + sprite.getGlobalBounds().width >= GameConfig::WINDOW_WIDTH)
-            direction *= -1;
-    }
-    void updatePhase() {
-        if (health <= GameConfig::BOSS_PHASE3_HP)
-            phase = PHASE3;
-        else if (health <= GameConfig::BOSS_PHASE2_HP)
-            phase = PHASE2;
-        else
-            phase = PHASE1;
-    }
-};
-
-// --- Health PowerUp Entity ---
-class HealthPowerUp {
-public:
-    sf::Sprite sprite;
-    float speed;
-    bool active;
-    HealthPowerUp(const sf::Texture& tex, sf::Vector2f pos, float spd)
-        : speed(spd), active(true)
-    {
-        sprite.setTexture(tex);
-        sprite.setPosition(pos);
-    }
-    void update() {
-        sprite.move(0.f, speed);
-        if (sprite.getPosition().y > GameConfig::WINDOW_HEIGHT)
-            active = false;
-    }
-};
-
-// --- OOP Game Class ---
-class SpaceInvadersGame {
-public:
-    enum GameState { START, PLAYING, GAME_OVER, YOU_WON, YOU_LOSE, LEVEL_TRANSITION };
-
-    SpaceInvadersGame()
-        : window(sf::VideoMode(GameConfig::WINDOW_WIDTH, GameConfig::WINDOW_HEIGHT), "Simple Space Shooter"),
-        gameState(START),
-        scoreFile("scores.txt"),
-        fontSizeTitle(24), fontSizeMain(16), fontSizeSmall(10),
-        health(GameConfig::PLAYER_MAX_HEALTH), score(0), level(1),
-        bossSpawned(false), bossDefeated(false),
-        isShaking(false), shakeDuration(0.f), shakeIntensity(GameConfig::SHAKE_INTENSITY),
-        level1CompleteSoundPlayed(false), level2CompleteSoundPlayed(false),
-        inLevelTransition(false), nextLevel(1), bossMusicStarted(false),
-        level2EnemySpeed(GameConfig::ENEMY_SPEED_LEVEL2), level2SpawnRate(GameConfig::ENEMY_SPAWN_RATE_LEVEL2),
-        level2DoubleSpawnCounter(0), level2MaxEnemies(GameConfig::LEVEL2_MAX_ENEMIES),
-        timeSurvived(0.f), totalKills(0),
-        healthPowerUpTimer(0.f), healthPowerUpNextSpawn(0.f)
-    {
-        loadResources();
-        setupUI();
-        player.setPosition(400.f, 500.f);
-        scheduleNextHealthPowerUp();
-    }
-
-    void run() {
-        while (window.isOpen()) {
-            handleEvents();
-            update();
-            render();
-        }
-        cleanup();
-    }
-
-private:
-    // Window and state
-    sf::RenderWindow window;
-    GameState gameState;
-    const std::string scoreFile;
-
-    // Fonts and UI
-    sf::Font font;
-    const unsigned int fontSizeTitle, fontSizeMain, fontSizeSmall;
-    sf::Text startText, winText, loseText, scoreText, levelText;
-    sf::Text healthLabelText, healthValueText;
-    sf::RectangleShape healthBarBack, healthBarFront;
-    sf::Text bossHealthLabelText, bossHealthValueText;
-    sf::RectangleShape bossHealthBarBack, bossHealthBarFront;
-    sf::Text highScoreText, transitionText;
-
-    // Game variables
-    int health, score, level;
-    bool bossSpawned, bossDefeated;
-    int bossHealth;
-    int highScore;
-
-    // Sounds
-    sf::SoundBuffer bgBuffer, shootBuffer, explosionBuffer, winBuffer, loseBuffer, levelUpBuffer, levelCompleteBuffer, bossBuffer, healthPowerUpBuffer;
-    sf::Sound backgroundSound, shootSound, explosionSound, winSound, loseSound, levelUpSound, levelCompleteSound, bossSound, healthPowerUpSound;
-
-    // Textures
-    sf::Texture playerTex, enemyTex, bossTex;
-    std::vector<sf::Texture> bulletFrames;
-    std::vector<sf::Texture> level2EnemyFrames;
-    sf::Texture healthPowerUpTex;
-
-    // Entities
-    sf::Sprite player;
-    std::vector<Enemy*> enemies;
-    std::vector<Bullet> bullets;
-    std::vector<Explosion> explosions;
-    Boss boss;
-    std::vector<Bullet> bossBullets;
-    std::vector<HealthPowerUp> healthPowerUps;
-
-    // Timers and random
-    sf::Clock bossAttackClock, bossSpreadAttackClock, bossMinionSpawnClock;
-    std::mt19937 rng{ std::random_device{}() };
-    sf::Clock enemySpawnClock, shootClock, shakeClock, levelTransitionClock, gameTimer, healthPowerUpClock;
-
-    // Camera shake
-    bool isShaking;
-    float shakeDuration, shakeIntensity;
-
-    // Level up/transition
-    bool level1CompleteSoundPlayed, level2CompleteSoundPlayed;
-    bool inLevelTransition;
-    int nextLevel;
-
-    // Boss music
-    bool bossMusicStarted;
-
-    // Level 2 difficulty
-    float level2EnemySpeed, level2SpawnRate;
-    int level2DoubleSpawnCounter, level2MaxEnemies;
-
-    // Stats
-    float timeSurvived;
-    int totalKills;
-
-    // Health PowerUp
-    float healthPowerUpTimer;
-    float healthPowerUpNextSpawn;
-    
-    sf::Texture backgroundTexture;
-    sf::Sprite backgroundSprite;
-    
-  
-    // --- Resource Loading and UI Setup ---
-    void loadResources() {
-        // Font
-        font.loadFromFile("D:/OOP Project/Space Invaders/Space Invaders/assets/main_font.ttf");
-        if (!backgroundTexture.loadFromFile("D:/OOP Project/Space Invaders/Space Invaders/assets/background.png")) {
-            // Error handling if needed
-        }
-        backgroundSprite.setTexture(backgroundTexture);
-        // Sounds
-        bgBuffer.loadFromFile("D:/OOP Project/Space Invaders/Space Invaders/assets/background_music.wav");
-        shootBuffer.loadFromFile("D:/OOP Project/Space Invaders/Space Invaders/assets/shoot.wav");
-        explosionBuffer.loadFromFile("D:/OOP Project/Space Invaders/Space Invaders/assets/explosion.wav");
-        winBuffer.loadFromFile("D:/OOP Project/Space Invaders/Space Invaders/assets/win.wav");
-        loseBuffer.loadFromFile("D:/OOP Project/Space Invaders/Space Invaders/assets/lost.wav");
-        levelUpBuffer.loadFromFile("D:/OOP Project/Space Invaders/Space Invaders/assets/levelup.wav");
-        levelCompleteBuffer.loadFromFile("D:/OOP Project/Space Invaders/Space Invaders/assets/levelcom.wav");
-        bossBuffer.loadFromFile("D:/OOP Project/Space Invaders/Space Invaders/assets/boss.wav");
-        // Health powerup sound (optional, fallback to shoot if not found)
-        if (!healthPowerUpBuffer.loadFromFile("D:/OOP Project/Space Invaders/Space Invaders/assets/explosion.wav")) {
-            healthPowerUpSound.setBuffer(shootBuffer);
-        }
-        else {
-            healthPowerUpSound.setBuffer(healthPowerUpBuffer);
-        }
-
-        backgroundSound.setBuffer(bgBuffer);
-        shootSound.setBuffer(shootBuffer);
-        explosionSound.setBuffer(explosionBuffer);
-        winSound.setBuffer(winBuffer);
-        loseSound.setBuffer(loseBuffer);
-        levelUpSound.setBuffer(levelUpBuffer);
-        levelCompleteSound.setBuffer(levelCompleteBuffer);
-        bossSound.setBuffer(bossBuffer);
-
-        backgroundSound.setLoop(true);
-        backgroundSound.setVolume(40);
-        if (backgroundSound.getStatus() != sf::Sound::Playing)
-            backgroundSound.play();
-
-        bossSound.setLoop(true);
-        bossSound.setVolume(60);
-
-        // Textures
-        playerTex.loadFromFile("D:/OOP Project/Space Invaders/Space Invaders/assets/sprite_ship_3.png");
-        enemyTex.loadFromFile("D:/OOP Project/Space Invaders/Space Invaders/assets/big_boss1.png");
-        bossTex.loadFromFile("D:/OOP Project/Space Invaders/Space Invaders/assets/final_boss_animation/sprite_0.png");
-
-        bulletFrames.resize(5);
-        for (int i = 0; i < 5; ++i) {
-            bulletFrames[i].loadFromFile("D:/OOP Project/Space Invaders/Space Invaders/assets/blaster_player/sprite_" + std::to_string(i) + ".png");
-        }
-        level2EnemyFrames.resize(5);
-        for (int i = 0; i < 5; ++i) {
-            level2EnemyFrames[i].loadFromFile("D:/OOP Project/Space Invaders/Space Invaders/assets/invader_animation_2/sprite_" + std::to_string(i) + ".png");
-        }
-        // Health powerup texture
-        healthPowerUpTex.loadFromFile("D:/OOP Project/Space Invaders/Space Invaders/assets/health.png");
-        player.setTexture(playerTex);
-        sf::Vector2u windowSize = window.getSize();
-        sf::Vector2u textureSize = backgroundTexture.getSize();
-        backgroundSprite.setScale(
-            static_cast<float>(windowSize.x) / textureSize.x,
-            static_cast<float>(windowSize.y) / textureSize.y
-        );
-    }
-
-    void setupUI() {
-        startText = sf::Text("Press SPACE to Start", font, fontSizeTitle);
-        startText.setPosition(220.f, 300.f);
-
-        winText = sf::Text("YOU WON!\nPress R to Restart", font, fontSizeTitle);
-        winText.setFillColor(sf::Color::Green);
-        winText.setPosition(220.f, 250.f);
-
-        loseText = sf::Text("YOU LOSE!\nPress R to Retry", font, fontSizeTitle);
-        loseText.setFillColor(sf::Color::Red);
-        loseText.setPosition(220.f, 250.f);
-
-        scoreText = sf::Text("Score: 0", font, fontSizeMain);
-        scoreText.setPosition(10.f, 10.f);
-
-        levelText = sf::Text("Level 1", font, fontSizeMain);
-        levelText.setPosition(10.f, 35.f);
-
-        healthLabelText = sf::Text("Health:", font, fontSizeMain);
-        healthLabelText.setPosition(580.f - healthLabelText.getLocalBounds().width - 10.f, 10.f + (20.f - fontSizeMain) / 2.f);
-
-        healthValueText = sf::Text(std::to_string(GameConfig::PLAYER_MAX_HEALTH), font, fontSizeSmall);
-        healthValueText.setFillColor(sf::Color::Black);
-        healthValueText.setPosition(580.f + GameConfig::HEALTH_BAR_WIDTH / 2.f - 10.f, 10.f + GameConfig::HEALTH_BAR_HEIGHT / 2.f - fontSizeSmall / 2.f);
-
-        healthBarBack = sf::RectangleShape(sf::Vector2f(GameConfig::HEALTH_BAR_WIDTH, GameConfig::HEALTH_BAR_HEIGHT));
-        healthBarBack.setFillColor(sf::Color(50, 50, 50));
-        healthBarBack.setPosition(580.f, 10.f);
-
-        healthBarFront = sf::RectangleShape(sf::Vector2f(GameConfig::HEALTH_BAR_WIDTH, GameConfig::HEALTH_BAR_HEIGHT));
-        healthBarFront.setFillColor(sf::Color::Red);
-        healthBarFront.setPosition(580.f, 10.f);
-
-        bossHealthLabelText = sf::Text("Boss:", font, fontSizeMain);
-        bossHealthLabelText.setPosition(580.f - bossHealthLabelText.getLocalBounds().width - 10.f, 40.f + (20.f - fontSizeMain) / 2.f);
-
-        bossHealthValueText = sf::Text(std::to_string(GameConfig::BOSS_MAX_HEALTH), font, fontSizeSmall);
-        bossHealthValueText.setFillColor(sf::Color::Black);
-        bossHealthValueText.setPosition(580.f + GameConfig::HEALTH_BAR_WIDTH / 2.f - 10.f, 40.f + GameConfig::HEALTH_BAR_HEIGHT / 2.f - fontSizeSmall / 2.f);
-
-        bossHealthBarBack = sf::RectangleShape(sf::Vector2f(GameConfig::HEALTH_BAR_WIDTH, GameConfig::HEALTH_BAR_HEIGHT));
-        bossHealthBarBack.setFillColor(sf::Color(50, 50, 50));
-        bossHealthBarBack.setPosition(580.f, 40.f);
-
-        bossHealthBarFront = sf::RectangleShape(sf::Vector2f(GameConfig::HEALTH_BAR_WIDTH, GameConfig::HEALTH_BAR_HEIGHT));
-        bossHealthBarFront.setFillColor(sf::Color::Blue);
-        bossHealthBarFront.setPosition(580.f, 40.f);
-
-        highScore = getHighScore(scoreFile);
-        highScoreText = sf::Text("High Score: " + std::to_string(highScore), font, fontSizeMain);
-        highScoreText.setFillColor(sf::Color::Yellow);
-        highScoreText.setPosition(10.f, 60.f);
-
-        transitionText = sf::Text("", font, fontSizeTitle);
-        transitionText.setFillColor(sf::Color::Yellow);
-        transitionText.setStyle(sf::Text::Bold);
-        transitionText.setPosition(300.f, 250.f);
-    }
-
-    // --- Main Game Loop Methods ---
-    void handleEvents() {
-        sf::Event event;
-        while (window.pollEvent(event))
-            if (event.type == sf::Event::Closed)
-                window.close();
-    }
-
-    void update() {
-        window.setView(window.getDefaultView());
-        handleCameraShake();
-
-        switch (gameState) {
-        case START: handleStartScreen(); break;
-        case LEVEL_TRANSITION: handleLevelTransition(); break;
-        case YOU_WON:
-        case YOU_LOSE: handleGameOver(); break;
-        case PLAYING: handleGameplay(); break;
-        default: break;
-        }
-    }
-
-    void render() {
-        window.clear();
-        window.draw(backgroundSprite);  // draw background first
-        // draw other game entities next (player, bullets, enemies, etc.)
-        switch (gameState) {
-        case START:
-            window.draw(startText);
-            window.draw(highScoreText);
-            break;
-        case LEVEL_TRANSITION:
-            window.draw(transitionText);
-            window.draw(highScoreText);
-            break;
-        case YOU_WON:
-        case YOU_LOSE:
-            renderGameOver();
-            break;
-        case PLAYING:
-            renderGameplay();
-            break;
-        default: break;
-        }
-        window.display();
-    }
-
-    void cleanup() {
-        for (auto* e : enemies) delete e;
-    }
-
-    // --- Camera Shake ---
-    void handleCameraShake() {
-        if (isShaking && shakeClock.getElapsedTime().asSeconds() < shakeDuration) {
-            float offsetX = (rand() % 11 - 5) * shakeIntensity * 0.1f;
-            float offsetY = (rand() % 11 - 5) * shakeIntensity * 0.1f;
-            sf::View shakeView = window.getDefaultView();
-            shakeView.move(offsetX, offsetY);
-            window.setView(shakeView);
-        }
-        else {
-            isShaking = false;
-        }
-    }
-
-    // --- State Handlers ---
-    void handleStartScreen() {
-        gameTimer.restart();
-        totalKills = 0;
-        highScore = getHighScore(scoreFile);
-        highScoreText.setString("High Score: " + std::to_string(highScore));
-        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Space)) gameState = PLAYING;
-    }
-
-    void handleLevelTransition() {
-        if (levelTransitionClock.getElapsedTime().asSeconds() > 1.0f) {
-            gameState = PLAYING;
-            inLevelTransition = false;
-        }
-    }
-
-    void handleGameOver() {
-        static bool soundPlayed = false;
-        static bool scoreSaved = false;
-        if (!soundPlayed) {
-            if (backgroundSound.getStatus() == sf::Sound::Playing)
-                backgroundSound.stop();
-            if (bossSound.getStatus() == sf::Sound::Playing)
-                bossSound.stop();
-            if (gameState == YOU_WON) {
-                if (winSound.getStatus() != sf::Sound::Playing)
-                    winSound.play();
-            }
-            else {
-                if (loseSound.getStatus() != sf::Sound::Playing)
-                    loseSound.play();
-            }
-            soundPlayed = true;
-        }
-        if (!scoreSaved) {
-            appendScoreToFile(scoreFile, score);
-            highScore = getHighScore(scoreFile);
-            highScoreText.setString("High Score: " + std::to_string(highScore));
-            scoreSaved = true;
-            timeSurvived = gameTimer.getElapsedTime().asSeconds();
-        }
-        if (sf::Keyboard::isKeyPressed(sf::Keyboard::R)) {
-            resetGame();
-            soundPlayed = false;
-            scoreSaved = false;
-        }
-        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Q)) {
-            window.close();
-        }
-    }
-
-    void handleGameplay() {
-        handlePlayerInput();
-        handleShooting();
-        handleEnemySpawning();
-        handleLevelProgression();
-        handleBossSpawning();
-        updateEntities();
-        handleBossBehavior();
-        handleCollisions();
-        handleHealthPowerUpSpawning();
-        updateHealthPowerUps();
-    }
-
-    // --- Gameplay Logic ---
-    void handlePlayerInput() {
-        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Left) && player.getPosition().x > 0)
-            player.move(-0.5f, 0.f);
-        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Right) && player.getPosition().x + player.getGlobalBounds().width < window.getSize().x)
-            player.move(0.5f, 0.f);
-    }
-
-    void handleShooting() {
-        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Space) && shootClock.getElapsedTime().asMilliseconds() > 200) {
-            sf::FloatRect playerBounds = player.getGlobalBounds();
-            sf::Vector2f bulletPos(
-                playerBounds.left + playerBounds.width / 2.f,
-                playerBounds.top
-            );
-            sf::Sprite tempBulletSprite;
-            tempBulletSprite.setTexture(bulletFrames[0]);
-            sf::FloatRect bulletBounds = tempBulletSprite.getGlobalBounds();
-            bulletPos.x -= bulletBounds.width / 2.f;
-            bullets.emplace_back(bulletFrames, bulletPos);
-            if (shootSound.getStatus() != sf::Sound::Playing)
-                shootSound.play();
-            shootClock.restart();
-        }
-    }
-
-    void handleEnemySpawning() {
-        float spawnRate = (level == 1) ? GameConfig::ENEMY_SPAWN_RATE_LEVEL1 :
-            (level == 2) ? level2SpawnRate : GameConfig::ENEMY_SPAWN_RATE_DEFAULT;
-        if (enemySpawnClock.getElapsedTime().asSeconds() > spawnRate && level < 3) {
-            float x = static_cast<float>(rand() % 750);
-            if (level == 2) {
-                int currentLevel2Enemies = 0;
-                for (auto* e : enemies) {
-                    if (dynamic_cast<AnimatedEnemy*>(e)) currentLevel2Enemies++;
-                }
-                if (currentLevel2Enemies < level2MaxEnemies) {
-                    enemies.push_back(new AnimatedEnemy(level2EnemyFrames, sf::Vector2f(x, -50.f), level2EnemySpeed));
-                    level2DoubleSpawnCounter++;
-                    if (level2DoubleSpawnCounter % GameConfig::LEVEL2_DOUBLE_SPAWN_FREQ == 0 && currentLevel2Enemies + 1 < level2MaxEnemies) {
-                        float x2 = static_cast<float>(rand() % 750);
-                        enemies.push_back(new AnimatedEnemy(level2EnemyFrames, sf::Vector2f(x2, -50.f), level2EnemySpeed + GameConfig::LEVEL2_DOUBLE_SPAWN_SPEED_BONUS));
-                    }
-                }
-            }
-            else {
-                enemies.push_back(new Enemy(enemyTex, sf::Vector2f(x, -50.f)));
-            }
-            enemySpawnClock.restart();
-        }
-    }
-
-    void handleLevelProgression() {
-        if (level == 1 && score >= GameConfig::LEVEL2_SCORE_THRESHOLD && !inLevelTransition) {
-            level = 2;
-            levelText.setString("Level 2");
-            if (!level1CompleteSoundPlayed) {
-                if (levelUpSound.getStatus() != sf::Sound::Playing)
-                    levelUpSound.play();
-                level1CompleteSoundPlayed = true;
-            }
-            transitionText.setString("Level 2");
-            gameState = LEVEL_TRANSITION;
-            levelTransitionClock.restart();
-            inLevelTransition = true;
-        }
-        else if (level == 2 && score >= GameConfig::LEVEL3_SCORE_THRESHOLD && !inLevelTransition) {
-            level = 3;
-            levelText.setString("Final Boss!");
-            if (!level2CompleteSoundPlayed) {
-                if (levelCompleteSound.getStatus() != sf::Sound::Playing)
-                    levelCompleteSound.play();
-                level2CompleteSoundPlayed = true;
-            }
-            transitionText.setString("Final Level");
-            gameState = LEVEL_TRANSITION;
-            levelTransitionClock.restart();
-            inLevelTransition = true;
-            for (auto* e : enemies) delete e;
-            enemies.clear();
-        }
-    }
-
-    void handleBossSpawning() {
-        if (level == 3 && !bossSpawned) {
-            boss = Boss();
-            boss.sprite.setPosition(300.f, -100.f);
-            boss.health = GameConfig::BOSS_MAX_HEALTH;
-            bossHealth = GameConfig::BOSS_MAX_HEALTH;
-            bossHealthBarFront.setSize(sf::Vector2f(GameConfig::HEALTH_BAR_WIDTH, GameConfig::HEALTH_BAR_HEIGHT));
-            bossHealthValueText.setString(std::to_string(GameConfig::BOSS_MAX_HEALTH));
-            bossSpawned = true;
-            if (backgroundSound.getStatus() == sf::Sound::Playing)
-                backgroundSound.stop();
-            if (bossSound.getStatus() != sf::Sound::Playing)
-                bossSound.play();
-            bossMusicStarted = true;
-            bossAttackClock.restart();
-            bossSpreadAttackClock.restart();
-            bossMinionSpawnClock.restart();
-        }
-        if ((gameState == YOU_WON || gameState == YOU_LOSE) && bossMusicStarted) {
-            if (bossSound.getStatus() == sf::Sound::Playing)
-                bossSound.stop();
-            bossMusicStarted = false;
-        }
-    }
-
-    void updateEntities() {
-        for (auto& bullet : bullets) bullet.update();
-        for (auto* enemy : enemies) enemy->update();
-        for (auto& explosion : explosions) explosion.update();
-        for (auto& b : bossBullets) b.update();
-    }
-
-    void handleBossBehavior() {
-        if (bossSpawned && !bossDefeated) {
-            boss.update();
-            if (boss.sprite.getPosition().y < GameConfig::BOSS_DESCEND_Y)
-                boss.sprite.move(0.f, GameConfig::BOSS_DESCEND_SPEED);
-            boss.updatePhase();
-
-            float bossBulletSpeed = GameConfig::BOSS_BULLET_SPEED;
-            float bossAttackInterval = GameConfig::BOSS_ATTACK_INTERVAL;
-            if (boss.phase == Boss::PHASE2) {
-                bossBulletSpeed = GameConfig::BOSS_BULLET_SPEED_PHASE2;
-                bossAttackInterval = GameConfig::BOSS_ATTACK_INTERVAL_PHASE2;
-            }
-            else if (boss.phase == Boss::PHASE3) {
-                bossBulletSpeed = GameConfig::BOSS_BULLET_SPEED_PHASE3;
-                bossAttackInterval = GameConfig::BOSS_ATTACK_INTERVAL_PHASE3;
-            }
-
-            if (bossAttackClock.getElapsedTime().asSeconds() > bossAttackInterval) {
-                sf::Vector2f bossPos = boss.sprite.getPosition() + sf::Vector2f(40.f, 60.f);
-                bossBullets.emplace_back(bulletFrames, bossPos, sf::Vector2f(0.f, bossBulletSpeed));
-                bossAttackClock.restart();
-            }
-
-            if (boss.phase >= Boss::PHASE2 && bossSpreadAttackClock.getElapsedTime().asSeconds() > GameConfig::BOSS_SPREAD_BULLET_INTERVAL) {
-                sf::Vector2f bossPos = boss.sprite.getPosition() + sf::Vector2f(40.f, 60.f);
-                int n = GameConfig::BOSS_SPREAD_BULLET_COUNT;
-                float spread = GameConfig::BOSS_SPREAD_BULLET_ANGLE;
-                float angleStart = 90.f - spread / 2.f;
-                float angleStep = spread / (n - 1);
-                for (int i = 0; i < n; ++i) {
-                    float angle = angleStart + i * angleStep;
-                    float rad = angle * 3.14159265f / 180.f;
-                    sf::Vector2f vel(std::cos(rad) * bossBulletSpeed, std::sin(rad) * bossBulletSpeed);
-                    bossBullets.emplace_back(bulletFrames, bossPos, vel);
-                }
-                bossSpreadAttackClock.restart();
-            }
-
-            if (boss.phase == Boss::PHASE3 && bossMinionSpawnClock.getElapsedTime().asSeconds() > GameConfig::BOSS_MINION_SPAWN_INTERVAL) {
-                std::uniform_int_distribution<int> minionCountDist(1, 2);
-                int minionCount = minionCountDist(rng);
-                for (int i = 0; i < minionCount; ++i) {
-                    float minionX = boss.sprite.getPosition().x + 20.f + (rand() % 60) - 30.f;
-                    minionX = std::max(0.f, std::min(minionX, (float)(GameConfig::WINDOW_WIDTH - 40)));
-                    enemies.push_back(new AnimatedEnemy(level2EnemyFrames, sf::Vector2f(minionX, boss.sprite.getPosition().y + 80.f), level2EnemySpeed + 0.1f));
-                }
-                bossMinionSpawnClock.restart();
-            }
-
-            for (size_t i = 0; i < bullets.size(); ++i) {
-                if (bullets[i].sprite.getGlobalBounds().intersects(boss.sprite.getGlobalBounds())) {
-                    bullets.erase(bullets.begin() + i);
-                    boss.health -= GameConfig::BOSS_HIT_DAMAGE;
-                    bossHealth -= GameConfig::BOSS_HIT_DAMAGE;
-                    if (explosionSound.getStatus() != sf::Sound::Playing)
-                        explosionSound.play();
-                    isShaking = true;
-                    shakeClock.restart();
-                    float bossBarWidth = std::max(0.f, GameConfig::HEALTH_BAR_WIDTH * (float)boss.health / GameConfig::BOSS_MAX_HEALTH);
-                    bossHealthBarFront.setSize(sf::Vector2f(bossBarWidth, GameConfig::HEALTH_BAR_HEIGHT));
-                    bossHealthValueText.setString(std::to_string(std::max(0, boss.health)));
-                    break;
-                }
-            }
-            if (boss.health <= 0) {
-                if (boss.sprite.getPosition().y > GameConfig::WINDOW_HEIGHT) {
-                    explosions.emplace_back(boss.sprite.getPosition());
-                }
-                bossDefeated = true;
-                gameState = YOU_WON;
-            }
-        }
-    }
-
-    void handleCollisions() {
-        bullets.erase(std::remove_if(bullets.begin(), bullets.end(),
-            [](Bullet& b) { return b.sprite.getPosition().y < GameConfig::BULLET_OFFSCREEN_Y; }), bullets.end());
-        bossBullets.erase(std::remove_if(bossBullets.begin(), bossBullets.end(),
-            [](Bullet& b) {
-                sf::Vector2f pos = b.sprite.getPosition();
-                return pos.y > GameConfig::WINDOW_HEIGHT || pos.x < 0 || pos.x > GameConfig::WINDOW_WIDTH;
-            }), bossBullets.end());
-        explosions.erase(std::remove_if(explosions.begin(), explosions.end(),
-            [](Explosion& e) { return e.finished; }), explosions.end());
-
-        // --- Health PowerUp collision with bullets ---
-        for (size_t i = 0; i < bullets.size(); ++i) {
-            bool bulletErased = false;
-            // Check collision with health powerups
-            for (size_t h = 0; h < healthPowerUps.size(); ++h) {
-                if (healthPowerUps[h].active && bullets[i].sprite.getGlobalBounds().intersects(healthPowerUps[h].sprite.getGlobalBounds())) {
-                    // Play powerup sound
-                    if (healthPowerUpSound.getStatus() != sf::Sound::Playing)
-                        healthPowerUpSound.play();
-                    // Replenish health
-                    health += GameConfig::HEALTH_POWERUP_AMOUNT;
-                    if (health > GameConfig::PLAYER_MAX_HEALTH)
-                        health = GameConfig::PLAYER_MAX_HEALTH;
-                    healthBarFront.setSize(sf::Vector2f(GameConfig::HEALTH_BAR_WIDTH * (float)health / GameConfig::PLAYER_MAX_HEALTH, GameConfig::HEALTH_BAR_HEIGHT));
-                    healthValueText.setString(std::to_string(health));
-                    // Remove bullet and powerup
-                    bullets.erase(bullets.begin() + i);
-                    healthPowerUps[h].active = false;
-                    bulletErased = true;
-                    break;
-                }
-            }
-            if (bulletErased) {
-                i--;
-                continue;
-            }
-            // --- Enemy collision ---
-            for (size_t j = 0; j < enemies.size(); ++j) {
-                if (bullets[i].sprite.getGlobalBounds().intersects(enemies[j]->sprite.getGlobalBounds())) {
-                    explosions.emplace_back(enemies[j]->sprite.getPosition());
-                    delete enemies[j];
-                    enemies.erase(enemies.begin() + j);
-                    bullets.erase(bullets.begin() + i);
-                    if (explosionSound.getStatus() != sf::Sound::Playing)
-                        explosionSound.play();
-                    isShaking = true;
-                    shakeDuration = GameConfig::SHAKE_DURATION;
-                    shakeClock.restart();
-                    score += 10;
-                    scoreText.setString("Score: " + std::to_string(score));
-                    healthValueText.setString(std::to_string(health));
-                    if (score > highScore) {
-                        highScore = score;
-                        highScoreText.setString("High Score: " + std::to_string(highScore));
-                    }
-                    bulletErased = true;
-                    i--;
-                    totalKills++;
-                    break;
-                }
-            }
-            if (bulletErased) break;
-        }
-        for (auto it = bossBullets.begin(); it != bossBullets.end();) {
-            if (it->sprite.getGlobalBounds().intersects(player.getGlobalBounds())) {
-                it = bossBullets.erase(it);
-                health -= GameConfig::BOSS_BULLET_DAMAGE;
-                healthBarFront.setSize(sf::Vector2f(GameConfig::HEALTH_BAR_WIDTH * (float)health / GameConfig::PLAYER_MAX_HEALTH, GameConfig::HEALTH_BAR_HEIGHT));
-                healthValueText.setString(std::to_string(std::max(0, health)));
-                if (health <= 0) gameState = YOU_LOSE;
-            }
-            else {
-                ++it;
-            }
-        }
-        for (auto it = enemies.begin(); it != enemies.end();) {
-            if ((*it)->sprite.getPosition().y > GameConfig::WINDOW_HEIGHT) {
-                explosions.emplace_back((*it)->sprite.getPosition());
-                if (explosionSound.getStatus() != sf::Sound::Playing)
-                    explosionSound.play();
-                isShaking = true;
-                shakeDuration = GameConfig::SHAKE_DURATION;
-                shakeClock.restart();
-                delete* it;
-                it = enemies.erase(it);
-                if (level == 1) {
-                    health -= GameConfig::ENEMY_DAMAGE_LEVEL1;
-                }
-                else if (level == 2) {
-                    health -= GameConfig::ENEMY_DAMAGE_LEVEL2;
-                }
-                else {
-                    health -= GameConfig::ENEMY_DAMAGE_DEFAULT;
-                }
-                healthBarFront.setSize(sf::Vector2f(GameConfig::HEALTH_BAR_WIDTH * (float)health / GameConfig::PLAYER_MAX_HEALTH, GameConfig::HEALTH_BAR_HEIGHT));
-                healthValueText.setString(std::to_string(std::max(0, health)));
-                if (health <= 0) gameState = YOU_LOSE;
-            }
-            else ++it;
-        }
-        // Remove inactive health powerups
-        healthPowerUps.erase(
-            std::remove_if(healthPowerUps.begin(), healthPowerUps.end(),
-                [](const HealthPowerUp& h) { return !h.active; }),
-            healthPowerUps.end()
-        );
-    }
-
-    // --- Health PowerUp Spawning and Update ---
-    void handleHealthPowerUpSpawning() {
-        // Only spawn health powerup if health is below 50
-        if (health < 50) {
-            float elapsed = healthPowerUpClock.getElapsedTime().asSeconds();
-            if (elapsed > healthPowerUpNextSpawn) {
-                float x = static_cast<float>(rand() % (GameConfig::WINDOW_WIDTH - 40) + 20);
-                healthPowerUps.emplace_back(healthPowerUpTex, sf::Vector2f(x, -40.f), GameConfig::HEALTH_POWERUP_SPEED);
-                healthPowerUpClock.restart();
-                scheduleNextHealthPowerUp();
-            }
-        }
-    }
-    void updateHealthPowerUps() {
-        for (auto& h : healthPowerUps) {
-            if (h.active)
-                h.update();
-        }
-    }
-    void scheduleNextHealthPowerUp() {
-        std::uniform_real_distribution<float> dist(GameConfig::HEALTH_POWERUP_SPAWN_MIN, GameConfig::HEALTH_POWERUP_SPAWN_MAX);
-        healthPowerUpNextSpawn = dist(rng);
-        healthPowerUpClock.restart();
-    }
-
-    // --- Rendering ---
-    void renderGameplay() {
-        window.draw(player);
-        window.draw(healthBarBack);
-        window.draw(healthBarFront);
-        window.draw(healthLabelText);
-        window.draw(healthValueText);
-        if (bossSpawned && !bossDefeated) {
-            window.draw(bossHealthBarBack);
-            window.draw(bossHealthBarFront);
-            window.draw(bossHealthLabelText);
-            window.draw(bossHealthValueText);
-        }
-        for (auto& bullet : bullets) window.draw(bullet.sprite);
-        for (auto* enemy : enemies) window.draw(enemy->sprite);
-        for (auto& explosion : explosions) window.draw(explosion.sprite);
-        // Draw health powerups only if health is below 50
-        if (health < 50) {
-            for (auto& h : healthPowerUps)
-                if (h.active)
-                    window.draw(h.sprite);
-        }
-        if (bossSpawned && !bossDefeated)
-            window.draw(boss.sprite);
-        for (auto& b : bossBullets)
-            window.draw(b.sprite);
-        window.draw(scoreText);
-        window.draw(levelText);
-        window.draw(highScoreText);
-    }
-
-    void renderGameOver() {
-        if (gameState == YOU_WON)
-            window.draw(winText);
-        else
-            window.draw(loseText);
-        window.draw(scoreText);
-        window.draw(highScoreText);
-
-        char timeBuffer[64];
-        int minutes = static_cast<int>(timeSurvived) / 60;
-        int seconds = static_cast<int>(timeSurvived) % 60;
-        snprintf(timeBuffer, sizeof(timeBuffer), "Time Survived: %02d:%02d", minutes, seconds);
-
-        sf::Text timeText(timeBuffer, font, fontSizeMain);
-        timeText.setFillColor(sf::Color::Cyan);
-        timeText.setPosition(220.f, 320.f);
-
-        sf::Text killsText("Total Kills: " + std::to_string(totalKills), font, fontSizeMain);
-        killsText.setFillColor(sf::Color::Magenta);
-        killsText.setPosition(220.f, 350.f);
-
-        sf::Text quitText("Press Q to Quit", font, fontSizeMain);
-        quitText.setFillColor(sf::Color(200, 200, 200));
-        quitText.setPosition(220.f, 380.f);
-
-        window.draw(timeText);
-        window.draw(killsText);
-        window.draw(quitText);
-    }
-
-    // --- Reset ---
-    void resetGame() {
-        health = GameConfig::PLAYER_MAX_HEALTH;
-        score = 0;
-        level = 1;
-        for (auto* e : enemies) delete e;
-        enemies.clear();
-        bullets.clear();
-        explosions.clear();
-        bossSpawned = false;
-        bossDefeated = false;
-        bossHealth = GameConfig::BOSS_MAX_HEALTH;
-        boss.health = GameConfig::BOSS_MAX_HEALTH;
-        scoreText.setString("Score: 0");
-        levelText.setString("Level 1");
-        healthBarFront.setSize(sf::Vector2f(GameConfig::HEALTH_BAR_WIDTH, GameConfig::HEALTH_BAR_HEIGHT));
-        healthValueText.setString(std::to_string(GameConfig::PLAYER_MAX_HEALTH));
-        bossHealthBarFront.setSize(sf::Vector2f(GameConfig::HEALTH_BAR_WIDTH, GameConfig::HEALTH_BAR_HEIGHT));
-        bossHealthValueText.setString(std::to_string(GameConfig::BOSS_MAX_HEALTH));
-        level1CompleteSoundPlayed = false;
-        level2CompleteSoundPlayed = false;
-        bossMusicStarted = false;
-        gameTimer.restart();
-        totalKills = 0;
-        highScore = getHighScore(scoreFile);
-        highScoreText.setString("High Score: " + std::to_string(highScore));
-        if (backgroundSound.getStatus() != sf::Sound::Playing)
-            backgroundSound.play();
-        // Reset health powerups
-        healthPowerUps.clear();
-        scheduleNextHealthPowerUp();
-        gameState = PLAYING;
-    }
-};
-
-// --- Main Entry Point ---
-int main() {
-    SpaceInvadersGame game;
-    game.run();
-    return 0;
+#include <SFML/Graphics.hpp>
+#include <SFML/Audio.hpp>
+#include <vector>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <string>
+#include <random>
+#include <memory>
+#include <cstring>
+#include <cstdlib>
+#include <cmath>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <unordered_map>
+#include <limits>
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define SPACE_INVADERS_X86
+#include <immintrin.h>
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// --- Game Configuration Struct ---
+
+struct GameConfig {
+    static constexpr int PLAYER_MAX_HEALTH = 100;
+
+    static constexpr int BOSS_MAX_HEALTH = 120;
+
+    static constexpr int ENEMY_DAMAGE_LEVEL1 = 10;
+    static constexpr int ENEMY_DAMAGE_LEVEL2 = 20;
+    static constexpr int ENEMY_DAMAGE_DEFAULT = 20;
+
+    static constexpr int BOSS_BULLET_DAMAGE = 30;
+
+    static constexpr float ENEMY_SPEED_LEVEL1 = 0.25f;
+    static constexpr float ENEMY_SPEED_LEVEL2 = 0.33f;
+    static constexpr float ENEMY_SPAWN_RATE_LEVEL1 = 1.5f;
+    static constexpr float ENEMY_SPAWN_RATE_LEVEL2 = 1.1f;
+    static constexpr float ENEMY_SPAWN_RATE_DEFAULT = 1000.f;
+
+    static constexpr int LEVEL2_SCORE_THRESHOLD = 80;
+    static constexpr int LEVEL3_SCORE_THRESHOLD = 140;
+    static constexpr int LEVEL2_MAX_ENEMIES = 4;
+    static constexpr int LEVEL2_DOUBLE_SPAWN_FREQ = 5;
+    static constexpr float LEVEL2_DOUBLE_SPAWN_SPEED_BONUS = 0.03f;
+
+    static constexpr float BOSS_MOVE_SPEED = 0.5f;
+    static constexpr float BOSS_DESCEND_Y = 100.f;
+    static constexpr float BOSS_DESCEND_SPEED = 0.2f;
+    static constexpr float BOSS_BULLET_SPEED = 0.5f;
+    static constexpr float BOSS_BULLET_SPEED_PHASE2 = 1.0f;
+    static constexpr float BOSS_BULLET_SPEED_PHASE3 = 1.2f;
+    static constexpr float BOSS_ATTACK_INTERVAL = 1.f;
+    static constexpr float BOSS_ATTACK_INTERVAL_PHASE2 = 0.7f;
+    static constexpr float BOSS_ATTACK_INTERVAL_PHASE3 = 0.5f;
+    static constexpr int BOSS_BULLET_DAMAGE_AMOUNT = 30;
+    static constexpr int BOSS_HIT_DAMAGE = 10;
+    static constexpr int BOSS_PHASE2_HP = 80;
+    static constexpr int BOSS_PHASE3_HP = 50;
+    static constexpr float BOSS_SPREAD_BULLET_INTERVAL = 3.0f;
+    static constexpr float BOSS_MINION_SPAWN_INTERVAL = 3.0f;
+    static constexpr int BOSS_SPREAD_BULLET_COUNT = 4;
+    static constexpr float BOSS_SPREAD_BULLET_ANGLE = 40.f;
+
+    static constexpr float BULLET_ANIMATION_INTERVAL_MS = 40.f;
+    static constexpr float BULLET_MOVE_SPEED = -1.f;
+    static constexpr int BULLET_OFFSCREEN_Y = 0;
+
+    static constexpr float EXPLOSION_ANIMATION_INTERVAL_MS = 80.f;
+    static constexpr int EXPLOSION_FRAMES = 8;
+
+    static constexpr float HEALTH_BAR_WIDTH = 200.f;
+    static constexpr float HEALTH_BAR_HEIGHT = 20.f;
+    static constexpr float SHAKE_INTENSITY = 10.f;
+    static constexpr float SHAKE_DURATION = 0.3f;
+
+    static constexpr int WINDOW_WIDTH = 800;
+    static constexpr int WINDOW_HEIGHT = 600;
+
+    // Powerup config
+    static constexpr float HEALTH_POWERUP_SPEED = 0.25f;
+    static constexpr float HEALTH_POWERUP_SPAWN_MIN = 8.0f; // seconds
+    static constexpr float HEALTH_POWERUP_SPAWN_MAX = 15.0f; // seconds
+    static constexpr int HEALTH_POWERUP_AMOUNT = 50;
+    static constexpr int HEALTH_POWERUP_MAX = 100;
+
+    // Simulation timing (all movement speeds above are per tick)
+    static constexpr int SIM_TICKS_PER_SECOND = 500;
+    static constexpr int SIM_TICK_MICROSECONDS = 1000000 / SIM_TICKS_PER_SECOND;
+    static constexpr int MAX_TICKS_PER_FRAME = 50; // catch-up limit per simulation thread wake-up
+    static constexpr int REPLAY_KEYFRAME_INTERVAL = 2 * SIM_TICKS_PER_SECOND;
+    static constexpr sf::Uint32 REPLAY_KEYFRAME_MAX_BYTES = 64 << 20; // unpacked; larger ones are treated as corrupt
+    static constexpr float REPLAY_SEEK_STEP = 5.f; // seconds per arrow key press while watching
+    static constexpr float TIME_SCALE_MIN = 0.25f;
+    static constexpr float TIME_SCALE_MAX = 100.f;
+
+    // Job system: loops over fewer entities than this run inline on the simulation thread
+    static constexpr int JOB_GRAIN_SIZE = 512;
+    // Spatial queries cost more each, so batches are split finer
+    static constexpr int SPATIAL_QUERY_GRAIN = 64;
+
+    // Collision broadphase: side of a uniform grid cell, about one enemy across
+    static constexpr int COLLISION_CELL_SIZE = 64;
+    // Loose quadtree: a node splits past this many items, down to this depth
+    static constexpr int QUADTREE_NODE_CAPACITY = 16;
+    static constexpr int QUADTREE_MAX_DEPTH = 8;
+    // Pixels at least this opaque are solid in collision masks
+    static constexpr int COLLISION_ALPHA_THRESHOLD = 128;
+
+    // Sprite atlas: packed rows are at most this wide, with this many clear pixels around each texture
+    static constexpr int ATLAS_WIDTH = 2048;
+    static constexpr int ATLAS_PADDING = 1;
+
+    // HUD counters have room for this many characters
+    static constexpr int HUD_COUNTER_LENGTH = 10;
+
+    // Gameplay events buffered per tick before audio, score and effects handle them
+    static constexpr int EVENT_QUEUE_CAPACITY = 256;
+};
+
+// Helper functions 
+std::vector<int> readScoresFromFile(const std::string& filename) {
+    std::vector<int> scores;
+    std::ifstream infile(filename);
+    int s;
+    while (infile >> s) {
+        scores.push_back(s);
+    }
+    return scores;
+}
+void appendScoreToFile(const std::string& filename, int score) {
+    std::ofstream outfile(filename, std::ios::app);
+    if (outfile.is_open()) {
+        outfile << score << std::endl;
+    }
+}
+int getHighScore(const std::string& filename) {
+    std::vector<int> scores = readScoresFromFile(filename);
+    if (!scores.empty()) {
+        return *std::max_element(scores.begin(), scores.end());
+    }
+    return 0;
+}
+
+// --- Simulation Time ---
+// Gameplay timers count fixed simulation ticks instead of wall time, so the
+// same inputs always produce the same run no matter how fast it is stepped.
+class SimTime {
+public:
+    static sf::Uint64 ticks;
+    static sf::Time now() { return sf::microseconds(static_cast<sf::Int64>(ticks) * GameConfig::SIM_TICK_MICROSECONDS); }
+};
+sf::Uint64 SimTime::ticks = 0;
+
+// Drop-in replacement for sf::Clock that reads simulation time.
+class GameClock {
+public:
+    GameClock() : startTick(SimTime::ticks) {}
+    sf::Time getElapsedTime() const {
+        return sf::microseconds(static_cast<sf::Int64>(SimTime::ticks - startTick) * GameConfig::SIM_TICK_MICROSECONDS);
+    }
+    sf::Time restart() {
+        sf::Time elapsed = getElapsedTime();
+        startTick = SimTime::ticks;
+        return elapsed;
+    }
+    sf::Uint64 getStartTick() const { return startTick; }
+    void setStartTick(sf::Uint64 tick) { startTick = tick; }
+private:
+    sf::Uint64 startTick;
+};
+
+// --- State Hashing ---
+// Rolling hash of the simulation state with one part per category. A record's
+// hash is a sum of one term per 64-bit word, and a category's part is the sum
+// over its entities, so both can be updated incrementally. Each entity keeps the
+// share it added to its part, whatever changes the entity swaps that share for
+// its new hash, and a despawn subtracts it. Positions change every tick, so
+// moving entities hash them apart from the rest of their record, and
+// FixedPosition folds in the difference each time it moves one.
+class StateHash {
+public:
+    enum Category { GAME, PLAYER, BOSS, BULLETS, ENEMIES, BOSS_BULLETS, EXPLOSIONS, POWERUPS, CATEGORY_COUNT };
+
+    static const char* name(int category) {
+        static const char* const names[CATEGORY_COUNT] = { "game", "player", "boss", "bullets", "enemies", "boss bullets", "explosions", "powerups" };
+        return names[category];
+    }
+
+    // Each word offset has its own odd multiplier, so changing any single word
+    // always changes the hash, and in the top byte with 255/256 probability.
+    static sf::Uint64 term(size_t offset, sf::Uint64 word) {
+        return (word ^ (word >> 29)) * (0x9E3779B97F4A7C15ULL + offset / 4);
+    }
+    template <typename T>
+    static sf::Uint64 ofRecord(const T& record, size_t firstWord = 0) {
+        static_assert(sizeof(T) % 8 == 0, "hashed records are padded to 8 bytes");
+        sf::Uint64 words[sizeof(T) / 8];
+        std::memcpy(words, &record, sizeof(T));
+        sf::Uint64 h = 0;
+        for (size_t i = firstWord; i < sizeof(T) / 8; ++i)
+            h += term(8 * i, words[i]);
+        return h;
+    }
+    // An entity's record without its leading position words (T::State::POSITION_WORDS).
+    template <typename T>
+    static sf::Uint64 of(const T& entity) {
+        typename T::State s;
+        std::memset(&s, 0, sizeof(s));
+        entity.saveState(s);
+        return ofRecord(s, T::State::POSITION_WORDS);
+    }
+    // The position words a moving entity leaves out of of(): float x, y then fx, fy.
+    template <typename T>
+    static sf::Uint64 ofPosition(const T& entity) {
+        return ofPosition(entity.sprite.getPosition(), entity.fixedPosition.packed());
+    }
+    static sf::Uint64 ofPosition(sf::Vector2f position, sf::Uint64 fixed) {
+        return term(0, word(position)) + term(8, fixed);
+    }
+    template <typename V>
+    static sf::Uint64 word(const V& value) {
+        static_assert(sizeof(V) == 8, "positions are one 64-bit word");
+        sf::Uint64 w;
+        std::memcpy(&w, &value, 8);
+        return w;
+    }
+    // Two scalars as one word, so records built from them have no padding
+    static sf::Uint64 word(sf::Int32 low, sf::Int32 high) {
+        return static_cast<sf::Uint32>(low) | static_cast<sf::Uint64>(static_cast<sf::Uint32>(high)) << 32;
+    }
+
+    // What one entity, or its position, added to a part. Until the entity is
+    // added to a part, updates only keep the value.
+    struct Share {
+        sf::Uint64* part = nullptr;
+        sf::Uint64 value = 0;
+
+        void update(sf::Uint64 fresh) {
+            if (part)
+                *part += fresh - value;
+            value = fresh;
+        }
+    };
+
+    void add(Category c, Share& share, sf::Uint64 h) {
+        share.part = &parts[c];
+        share.value = h;
+        parts[c] += h;
+    }
+    void remove(Category c, const Share& share) { parts[c] -= share.value; }
+    void set(Category c, sf::Uint64 h) { parts[c] = h; }
+    sf::Uint64 part(Category c) const { return parts[c]; }
+
+    // All parts folded into one byte, as recorded after every replay tick. The
+    // parts are sums of multiplied terms already, so adding them up is enough.
+    sf::Uint8 fold() const {
+        sf::Uint64 h = 0;
+        for (int c = 0; c < CATEGORY_COUNT; ++c)
+            h += parts[c];
+        return static_cast<sf::Uint8>(h >> 56);
+    }
+    // The top byte of each part, recorded once per keyframe interval so a
+    // mismatch can be narrowed down to categories.
+    sf::Uint64 digest() const {
+        static_assert(CATEGORY_COUNT == 8, "one digest byte per category");
+        return (parts[0] >> 56) | (parts[1] >> 56 << 8) | (parts[2] >> 56 << 16) | (parts[3] >> 56 << 24) |
+            (parts[4] >> 56 << 32) | (parts[5] >> 56 << 40) | (parts[6] >> 56 << 48) | (parts[7] >> 56 << 56);
+    }
+    // Names the categories whose bytes differ between two digests.
+    static std::string mismatch(sf::Uint64 a, sf::Uint64 b) {
+        std::string names;
+        for (int c = 0; c < CATEGORY_COUNT; ++c) {
+            if (((a ^ b) >> (8 * c)) & 0xFF) {
+                if (!names.empty()) names += ", ";
+                names += name(c);
+            }
+        }
+        return names;
+    }
+
+private:
+    sf::Uint64 parts[CATEGORY_COUNT] = {};
+};
+
+// --- Collision Bounds ---
+// Axis-aligned box as four floats. Entities update theirs whenever they move, so
+// collision and bounds checks read it directly instead of transforming the sprite.
+// No sprite here is rotated, scaled or given an origin, so the box is the
+// position plus the texture rect, exactly as getGlobalBounds() would compute it.
+struct Aabb {
+    float left = 0.f, top = 0.f, right = 0.f, bottom = 0.f;
+
+    static Aabb of(const sf::Sprite& sprite) {
+        const sf::Vector2f position = sprite.getPosition();
+        const sf::IntRect& rect = sprite.getTextureRect();
+        Aabb b;
+        b.left = position.x;
+        b.top = position.y;
+        b.right = position.x + static_cast<float>(std::abs(rect.width));
+        b.bottom = position.y + static_cast<float>(std::abs(rect.height));
+        return b;
+    }
+    float width() const { return right - left; }
+    float height() const { return bottom - top; }
+    bool intersects(const Aabb& o) const {
+        return left < o.right && o.left < right && top < o.bottom && o.top < bottom;
+    }
+};
+
+// A box turned about its center, for projectiles that fly along their heading.
+// Against an upright box the separating axis test has four axes to try: the
+// upright box's own two, which comparing with bounds() covers, and this box's two.
+struct Obb {
+    sf::Vector2f center, half; // half extents along its own axes
+    sf::Vector2f axisX, axisY; // of unit length; axisY points along the heading
+
+    // 'upright' turned about its center until its +y side faces 'heading'
+    static Obb of(const Aabb& upright, sf::Vector2f heading) {
+        Obb o;
+        o.center = sf::Vector2f((upright.left + upright.right) * 0.5f, (upright.top + upright.bottom) * 0.5f);
+        o.half = sf::Vector2f(upright.width() * 0.5f, upright.height() * 0.5f);
+        o.axisY = heading / std::sqrt(heading.x * heading.x + heading.y * heading.y);
+        o.axisX = sf::Vector2f(o.axisY.y, -o.axisY.x);
+        return o;
+    }
+    Aabb bounds() const {
+        const float rx = half.x * std::abs(axisX.x) + half.y * std::abs(axisY.x);
+        const float ry = half.x * std::abs(axisX.y) + half.y * std::abs(axisY.y);
+        Aabb b;
+        b.left = center.x - rx;
+        b.top = center.y - ry;
+        b.right = center.x + rx;
+        b.bottom = center.y + ry;
+        return b;
+    }
+    // Strict, like Aabb::intersects
+    bool intersects(const Aabb& b) const {
+        if (!bounds().intersects(b))
+            return false;
+        const sf::Vector2f d((b.left + b.right) * 0.5f - center.x, (b.top + b.bottom) * 0.5f - center.y);
+        const float hx = b.width() * 0.5f, hy = b.height() * 0.5f;
+        return std::abs(d.x * axisX.x + d.y * axisX.y) < half.x + hx * std::abs(axisX.x) + hy * std::abs(axisX.y) &&
+            std::abs(d.x * axisY.x + d.y * axisY.y) < half.y + hx * std::abs(axisY.x) + hy * std::abs(axisY.y);
+    }
+};
+
+// --- Batch Overlap Tests ---
+// Boxes stored column by column, so one probe can be tested against a block of
+// them at once. Every column has a block of empty boxes past the end, so a
+// kernel may read a whole block starting at any index below count.
+struct AabbColumns {
+    static constexpr size_t BLOCK = 16;
+    std::vector<float> left, top, right, bottom;
+    size_t count = 0;
+
+    void resize(size_t n) {
+        count = n;
+        left.resize(n + BLOCK);
+        top.resize(n + BLOCK);
+        right.resize(n + BLOCK);
+        bottom.resize(n + BLOCK);
+        for (size_t i = n; i < n + BLOCK; ++i)
+            set(i, Aabb());
+    }
+    void set(size_t i, const Aabb& b) {
+        left[i] = b.left;
+        top[i] = b.top;
+        right[i] = b.right;
+        bottom[i] = b.bottom;
+    }
+    void push(const Aabb& b) {
+        if (left.size() < count + 1 + BLOCK) {
+            left.push_back(0.f);
+            top.push_back(0.f);
+            right.push_back(0.f);
+            bottom.push_back(0.f);
+        }
+        set(count++, b);
+        set(count + BLOCK - 1, Aabb());
+    }
+    void pop() {
+        set(--count, Aabb());
+    }
+};
+
+#if defined(SPACE_INVADERS_X86) && !defined(_MSC_VER)
+#define AVX2_FUNCTION __attribute__((target("avx2")))
+#else
+#define AVX2_FUNCTION
+#endif
+
+// One box against a block of AabbColumns, as a bitmask: bit k is set when the
+// probe overlaps box first + k. The comparisons are the same strict ones as
+// Aabb::intersects, so every kernel gives identical results. SSE2 tests four
+// boxes per instruction, AVX2 eight; the best one the CPU has is picked at startup.
+class OverlapKernel {
+public:
+    typedef sf::Uint32 (*Function)(const Aabb& probe, const AabbColumns& boxes, size_t first);
+    static const Function overlap;
+
+    static sf::Uint32 scalar(const Aabb& probe, const AabbColumns& boxes, size_t first) {
+        sf::Uint32 mask = 0;
+        for (size_t k = 0; k < AabbColumns::BLOCK; ++k) {
+            const size_t i = first + k;
+            if (probe.left < boxes.right[i] && boxes.left[i] < probe.right && probe.top < boxes.bottom[i] && boxes.top[i] < probe.bottom)
+                mask |= 1u << k;
+        }
+        return mask;
+    }
+#ifdef SPACE_INVADERS_X86
+    static sf::Uint32 sse2(const Aabb& probe, const AabbColumns& boxes, size_t first) {
+        const __m128 left = _mm_set1_ps(probe.left), top = _mm_set1_ps(probe.top);
+        const __m128 right = _mm_set1_ps(probe.right), bottom = _mm_set1_ps(probe.bottom);
+        sf::Uint32 mask = 0;
+        for (size_t k = 0; k < AabbColumns::BLOCK; k += 4) {
+            const size_t i = first + k;
+            const __m128 x = _mm_and_ps(_mm_cmplt_ps(left, _mm_loadu_ps(&boxes.right[i])), _mm_cmplt_ps(_mm_loadu_ps(&boxes.left[i]), right));
+            const __m128 y = _mm_and_ps(_mm_cmplt_ps(top, _mm_loadu_ps(&boxes.bottom[i])), _mm_cmplt_ps(_mm_loadu_ps(&boxes.top[i]), bottom));
+            mask |= static_cast<sf::Uint32>(_mm_movemask_ps(_mm_and_ps(x, y))) << k;
+        }
+        return mask;
+    }
+    static AVX2_FUNCTION sf::Uint32 avx2(const Aabb& probe, const AabbColumns& boxes, size_t first) {
+        const __m256 left = _mm256_set1_ps(probe.left), top = _mm256_set1_ps(probe.top);
+        const __m256 right = _mm256_set1_ps(probe.right), bottom = _mm256_set1_ps(probe.bottom);
+        sf::Uint32 mask = 0;
+        for (size_t k = 0; k < AabbColumns::BLOCK; k += 8) {
+            const size_t i = first + k;
+            const __m256 x = _mm256_and_ps(_mm256_cmp_ps(left, _mm256_loadu_ps(&boxes.right[i]), _CMP_LT_OQ),
+                _mm256_cmp_ps(_mm256_loadu_ps(&boxes.left[i]), right, _CMP_LT_OQ));
+            const __m256 y = _mm256_and_ps(_mm256_cmp_ps(top, _mm256_loadu_ps(&boxes.bottom[i]), _CMP_LT_OQ),
+                _mm256_cmp_ps(_mm256_loadu_ps(&boxes.top[i]), bottom, _CMP_LT_OQ));
+            mask |= static_cast<sf::Uint32>(_mm256_movemask_ps(_mm256_and_ps(x, y))) << k;
+        }
+        return mask;
+    }
+#endif
+
+    static bool hasAvx2() {
+#if defined(SPACE_INVADERS_X86) && defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] < 7)
+            return false;
+        __cpuid(info, 1);
+        const bool osSavesAvx = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && (_xgetbv(0) & 6) == 6;
+        __cpuidex(info, 7, 0);
+        return osSavesAvx && (info[1] & (1 << 5));
+#elif defined(SPACE_INVADERS_X86)
+        return __builtin_cpu_supports("avx2");
+#else
+        return false;
+#endif
+    }
+    static Function best() {
+#ifdef SPACE_INVADERS_X86
+        return hasAvx2() ? avx2 : sse2;
+#else
+        return scalar;
+#endif
+    }
+
+    // Mask of the first n results of a block
+    static sf::Uint32 firstBits(size_t n) {
+        return n >= AabbColumns::BLOCK ? (1u << AabbColumns::BLOCK) - 1 : (1u << n) - 1;
+    }
+    // Calls visit(k) for every set bit k, lowest first
+    template <typename F>
+    static void forEachBit(sf::Uint32 bits, F visit) {
+        while (bits) {
+#ifdef _MSC_VER
+            unsigned long k;
+            _BitScanForward(&k, bits);
+#else
+            const int k = __builtin_ctz(bits);
+#endif
+            visit(static_cast<size_t>(k));
+            bits &= bits - 1;
+        }
+    }
+};
+const OverlapKernel::Function OverlapKernel::overlap = OverlapKernel::best();
+
+// --- Deterministic Math ---
+// Optional Q16.16 fixed-point mode for the simulation. Each float operation is
+// exact, but libm trigonometry and compiler choices (FMA contraction, x87,
+// fast-math) still let builds disagree. In fixed-point mode entity motion is
+// integer addition and trigonometry comes from a table built with integer math,
+// so every build computes the same state bit for bit. The mode is chosen per
+// run and stored in replays.
+class FixedMath {
+public:
+    static bool enabled;
+    static constexpr sf::Int32 ONE = 1 << 16;
+
+    static sf::Int32 fromFloat(float v) { return static_cast<sf::Int32>(std::lround(v * 65536.f)); }
+    static float toFloat(sf::Int32 v) { return static_cast<float>(v) * (1.f / 65536.f); }
+    static sf::Int32 mul(sf::Int32 a, sf::Int32 b) { return static_cast<sf::Int32>((static_cast<sf::Int64>(a) * b) >> 16); }
+
+    // Sine and cosine of an angle in Q16.16 degrees, linearly interpolated from the table.
+    static sf::Int32 sinDeg(sf::Int32 degrees) {
+        static const bool built = buildTable();
+        (void)built;
+        const sf::Int64 turn = 360LL * ONE;
+        sf::Int64 angle = degrees % turn;
+        if (angle < 0)
+            angle += turn;
+        sf::Int64 position = angle * TABLE_SIZE * ONE / turn; // table index in Q16.16
+        int i = static_cast<int>(position >> 16);
+        sf::Int32 frac = static_cast<sf::Int32>(position & (ONE - 1));
+        return sineTable[i] + mul(sineTable[i + 1] - sineTable[i], frac);
+    }
+    static sf::Int32 cosDeg(sf::Int32 degrees) { return sinDeg(degrees + 90 * ONE); }
+
+private:
+    static constexpr int TABLE_SIZE = 1024; // entries per full turn
+    static sf::Int32 sineTable[TABLE_SIZE + 1];
+
+    // Quarter wave from a Taylor series in Q30 integers, mirrored to a full turn.
+    static bool buildTable() {
+        const sf::Int64 halfPiQ30 = 1686629713; // pi / 2 * 2^30
+        const int quarter = TABLE_SIZE / 4;
+        for (int k = 0; k <= quarter; ++k) {
+            sf::Int64 x = halfPiQ30 * k / quarter;
+            sf::Int64 term = x, sum = x;
+            for (int n = 1; n <= 7; ++n) {
+                term = ((term * x) >> 30) * x >> 30;
+                term /= (2 * n) * (2 * n + 1);
+                sum += (n % 2) ? -term : term;
+            }
+            sineTable[k] = static_cast<sf::Int32>((sum + (1 << 13)) >> 14);
+        }
+        for (int k = quarter + 1; k <= TABLE_SIZE / 2; ++k)
+            sineTable[k] = sineTable[TABLE_SIZE / 2 - k];
+        for (int k = TABLE_SIZE / 2 + 1; k <= TABLE_SIZE; ++k)
+            sineTable[k] = -sineTable[k - TABLE_SIZE / 2];
+        return true;
+    }
+};
+bool FixedMath::enabled = false;
+sf::Int32 FixedMath::sineTable[FixedMath::TABLE_SIZE + 1];
+
+// Q16.16 copy of a moving entity's position. In fixed-point mode it is the real
+// position and the sprite only mirrors it; otherwise the sprite is moved directly.
+// Either way the entity's collision bounds follow the sprite.
+// Every moving entity's State record starts with float x, y then fx, fy, which
+// are hashed on their own: each set and move updates the position's share of
+// the entity's state hash part (see StateHash::ofPosition).
+// Entities mostly move by the same delta every tick, so its Q16.16 form is kept
+// and only converted again when the delta changes.
+struct FixedPosition {
+    sf::Int32 x = 0, y = 0;
+    sf::Int32 stepX = 0, stepY = 0; // Q16.16 of stepDelta
+    sf::Vector2f stepDelta;
+    StateHash::Share hash;
+
+    void set(sf::Sprite& sprite, Aabb& bounds, sf::Vector2f position) {
+        sprite.setPosition(position);
+        bounds = Aabb::of(sprite);
+        x = FixedMath::fromFloat(position.x);
+        y = FixedMath::fromFloat(position.y);
+        hash.update(StateHash::ofPosition(position, packed()));
+    }
+    void move(sf::Sprite& sprite, Aabb& bounds, sf::Vector2f delta) {
+        if (!FixedMath::enabled) {
+            sprite.move(delta);
+            bounds = Aabb::of(sprite);
+            hash.update(StateHash::ofPosition(sprite.getPosition(), packed()));
+            return;
+        }
+        if (delta != stepDelta) {
+            stepDelta = delta;
+            stepX = FixedMath::fromFloat(delta.x);
+            stepY = FixedMath::fromFloat(delta.y);
+        }
+        x += stepX;
+        y += stepY;
+        sprite.setPosition(FixedMath::toFloat(x), FixedMath::toFloat(y));
+        bounds = Aabb::of(sprite);
+        hash.update(StateHash::ofPosition(sprite.getPosition(), packed()));
+    }
+    // x and y as one word, laid out as in the State records
+    sf::Uint64 packed() const {
+        return static_cast<sf::Uint32>(x) | static_cast<sf::Uint64>(static_cast<sf::Uint32>(y)) << 32;
+    }
+};
+
+// --- Time Control ---
+// Where real time comes from. The game reads the wall clock; tests and soak
+// runs can inject their own source to drive the simulation at any pace.
+class TimeSource {
+public:
+    virtual ~TimeSource() {}
+    virtual sf::Time now() = 0;
+};
+
+class WallTimeSource : public TimeSource {
+public:
+    sf::Time now() override { return clock.getElapsedTime(); }
+private:
+    sf::Clock clock;
+};
+
+// Converts real time into whole simulation ticks, with speed scaling, pause
+// and single-stepping. Game timers only see SimTime, so every one of them
+// warps along with it.
+class SimulationClock {
+public:
+    explicit SimulationClock(TimeSource& timeSource) : source(&timeSource) { lastReal = source->now(); }
+
+    void setSource(TimeSource& timeSource) {
+        source = &timeSource;
+        lastReal = source->now();
+    }
+
+    float getScale() const { return scale; }
+    void setScale(float s) { scale = std::max(GameConfig::TIME_SCALE_MIN, std::min(s, GameConfig::TIME_SCALE_MAX)); }
+
+    bool isPaused() const { return paused; }
+    void setPaused(bool p) {
+        paused = p;
+        pendingSteps = 0;
+        lag = 0.0;
+    }
+
+    // While paused, runs exactly this many more ticks.
+    void step(int ticks = 1) {
+        if (paused)
+            pendingSteps += ticks;
+    }
+
+    // Ticks due since the last call, at most maxTicks (scaled with the speed).
+    // Time beyond the cap is dropped so a long stall does not snowball.
+    int advance(int maxTicks) {
+        sf::Time now = source->now();
+        sf::Int64 real = (now - lastReal).asMicroseconds();
+        lastReal = now;
+        if (paused) {
+            int n = std::min(pendingSteps, maxTicks);
+            pendingSteps -= n;
+            return n;
+        }
+        maxTicks = static_cast<int>(maxTicks * std::max(1.f, scale));
+        lag += real * static_cast<double>(scale);
+        int n = static_cast<int>(lag / GameConfig::SIM_TICK_MICROSECONDS);
+        if (n >= maxTicks) {
+            lag = 0.0;
+            return maxTicks;
+        }
+        lag -= static_cast<double>(n) * GameConfig::SIM_TICK_MICROSECONDS;
+        return n;
+    }
+
+    // Real time until the next tick is due.
+    sf::Time untilNextTick() const {
+        if (paused)
+            return sf::microseconds(GameConfig::SIM_TICK_MICROSECONDS);
+        return sf::microseconds(static_cast<sf::Int64>((GameConfig::SIM_TICK_MICROSECONDS - lag) / scale));
+    }
+
+private:
+    TimeSource* source;
+    sf::Time lastReal;
+    double lag = 0.0; // simulation microseconds not yet turned into ticks
+    float scale = 1.f;
+    bool paused = false;
+    int pendingSteps = 0;
+};
+
+// --- Random Numbers ---
+// PCG32 generator. Its whole state is two integers, so keyframes can capture it,
+// and the output is the same with every compiler and standard library.
+class GameRandom {
+public:
+    sf::Uint64 state = 0, inc = 1;
+
+    void seed(sf::Uint64 initState) {
+        state = 0;
+        inc = (54u << 1u) | 1u;
+        next();
+        state += initState;
+        next();
+    }
+    sf::Uint32 next() {
+        sf::Uint64 old = state;
+        state = old * 6364136223846793005ULL + inc;
+        sf::Uint32 xorShifted = static_cast<sf::Uint32>(((old >> 18u) ^ old) >> 27u);
+        sf::Uint32 rot = static_cast<sf::Uint32>(old >> 59u);
+        return (xorShifted >> rot) | (xorShifted << ((32u - rot) & 31u));
+    }
+    // Uniform in [0, n)
+    int nextInt(int n) { return static_cast<int>(next() % static_cast<sf::Uint32>(n)); }
+    // Uniform in [min, max)
+    float nextFloat(float min, float max) {
+        // The float form can be contracted into an FMA, so fixed-point mode draws in Q16.16
+        if (FixedMath::enabled)
+            return FixedMath::toFloat(FixedMath::fromFloat(min) + FixedMath::mul(FixedMath::fromFloat(max - min), static_cast<sf::Int32>(next() >> 16)));
+        return min + (max - min) * static_cast<float>(next() >> 8) * (1.f / 16777216.f);
+    }
+};
+
+// --- Player Input ---
+// Everything the simulation reads from the keyboard in one tick, packed into a byte.
+struct InputFrame {
+    enum Button : sf::Uint8 { LEFT = 1, RIGHT = 2, FIRE = 4, RESTART = 8 };
+    sf::Uint8 bits = 0;
+
+    bool isDown(Button b) const { return (bits & b) != 0; }
+
+    static InputFrame sampleKeyboard() {
+        InputFrame f;
+        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Left)) f.bits |= LEFT;
+        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Right)) f.bits |= RIGHT;
+        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Space)) f.bits |= FIRE;
+        if (sf::Keyboard::isKeyPressed(sf::Keyboard::R)) f.bits |= RESTART;
+        return f;
+    }
+};
+
+// --- Replay ---
+// A replay is the RNG seed plus the per-tick input stream, run-length encoded,
+// followed by compressed full-state keyframes every keyframeInterval ticks so
+// playback can seek to any tick by restoring a keyframe and simulating forward.
+// A folded state hash byte after every tick lets playback find the tick a desync
+// starts at, and a per-category digest every keyframe interval tells what diverged.
+// File layout (little endian):
+//   "SIRP" | u16 version | u32 seed | u8 flags | u32 tick count | u32 run count
+//   then per run: u8 input bits | varint run length
+//   u32 hash count | u8 folded hash per tick
+//   u32 digest count | u64 category digest per keyframe interval
+//   u32 keyframe interval | u32 keyframe count
+//   then per keyframe: u32 raw size (0 = missing) | u32 packed size | packed bytes
+class Replay {
+public:
+    struct InputRun {
+        sf::Uint8 bits;
+        sf::Uint32 length;
+    };
+
+    // Keyframe i holds the state at the start of tick i * keyframeInterval.
+    struct Keyframe {
+        sf::Uint32 rawSize = 0;
+        std::vector<sf::Uint8> packed;
+    };
+
+    static constexpr sf::Uint16 VERSION = 6;
+    enum Flags : sf::Uint8 { FIXED_POINT = 1 };
+
+    sf::Uint32 seed = 0;
+    sf::Uint8 flags = 0;
+    sf::Uint32 tickCount = 0;
+    std::vector<InputRun> runs;
+    std::vector<sf::Uint8> stateHashes; // folded hash after every tick
+    std::vector<sf::Uint64> categoryDigests; // after every keyframeInterval-th tick
+    sf::Uint32 keyframeInterval = GameConfig::REPLAY_KEYFRAME_INTERVAL;
+    std::vector<Keyframe> keyframes;
+
+    void append(InputFrame input) {
+        if (!runs.empty() && runs.back().bits == input.bits)
+            runs.back().length++;
+        else
+            runs.push_back({ input.bits, 1 });
+        tickCount++;
+    }
+
+    bool hasKeyframe(size_t index) const {
+        return index < keyframes.size() && keyframes[index].rawSize > 0;
+    }
+
+    void storeKeyframe(size_t index, const std::vector<sf::Uint8>& state) {
+        if (keyframes.size() <= index)
+            keyframes.resize(index + 1);
+        keyframes[index].rawSize = static_cast<sf::Uint32>(state.size());
+        pack(state, keyframes[index].packed);
+    }
+
+    bool loadKeyframe(size_t index, std::vector<sf::Uint8>& state) const {
+        return hasKeyframe(index) && unpack(keyframes[index].packed, keyframes[index].rawSize, state);
+    }
+
+    bool saveToFile(const std::string& filename) const {
+        std::vector<sf::Uint8> out;
+        out.insert(out.end(), { 'S', 'I', 'R', 'P' });
+        writeInt(out, VERSION, 2);
+        writeInt(out, seed, 4);
+        out.push_back(flags);
+        writeInt(out, tickCount, 4);
+        writeInt(out, static_cast<sf::Uint32>(runs.size()), 4);
+        for (const auto& run : runs) {
+            out.push_back(run.bits);
+            writeVarint(out, run.length);
+        }
+        writeInt(out, static_cast<sf::Uint32>(stateHashes.size()), 4);
+        out.insert(out.end(), stateHashes.begin(), stateHashes.end());
+        writeInt(out, static_cast<sf::Uint32>(categoryDigests.size()), 4);
+        for (sf::Uint64 digest : categoryDigests) {
+            writeInt(out, static_cast<sf::Uint32>(digest), 4);
+            writeInt(out, static_cast<sf::Uint32>(digest >> 32), 4);
+        }
+        writeInt(out, keyframeInterval, 4);
+        writeInt(out, static_cast<sf::Uint32>(keyframes.size()), 4);
+        for (const auto& key : keyframes) {
+            writeInt(out, key.rawSize, 4);
+            writeInt(out, static_cast<sf::Uint32>(key.packed.size()), 4);
+            out.insert(out.end(), key.packed.begin(), key.packed.end());
+        }
+        std::ofstream file(filename, std::ios::binary);
+        if (!file.is_open()) return false;
+        file.write(reinterpret_cast<const char*>(out.data()), out.size());
+        return file.good();
+    }
+
+    bool loadFromFile(const std::string& filename) {
+        std::ifstream file(filename, std::ios::binary);
+        if (!file.is_open()) return false;
+        std::vector<sf::Uint8> in((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        size_t pos = 0;
+        sf::Uint32 version, runCount, hashCount = 0, digestCount = 0, keyframeCount;
+        if (in.size() < 19 || in[0] != 'S' || in[1] != 'I' || in[2] != 'R' || in[3] != 'P') return false;
+        pos = 4;
+        if (!readInt(in, pos, version, 2) || version != VERSION) return false;
+        if (!readInt(in, pos, seed, 4)) return false;
+        flags = in[pos++];
+        if (!readInt(in, pos, tickCount, 4) || !readInt(in, pos, runCount, 4)) return false;
+        runs.clear();
+        sf::Uint32 total = 0;
+        for (sf::Uint32 i = 0; i < runCount; ++i) {
+            InputRun run;
+            if (pos >= in.size()) return false;
+            run.bits = in[pos++];
+            if (!readVarint(in, pos, run.length) || run.length > tickCount - total) return false;
+            runs.push_back(run);
+            total += run.length;
+        }
+        if (total != tickCount) return false;
+        if (!readInt(in, pos, hashCount, 4) || hashCount > tickCount || pos + hashCount > in.size()) return false;
+        stateHashes.assign(in.begin() + pos, in.begin() + pos + hashCount);
+        pos += hashCount;
+        if (!readInt(in, pos, digestCount, 4) || digestCount > tickCount || (in.size() - pos) / 8 < digestCount) return false;
+        categoryDigests.assign(digestCount, 0);
+        for (auto& digest : categoryDigests) {
+            sf::Uint32 low, high;
+            if (!readInt(in, pos, low, 4) || !readInt(in, pos, high, 4)) return false;
+            digest = (static_cast<sf::Uint64>(high) << 32) | low;
+        }
+        if (!readInt(in, pos, keyframeInterval, 4) || keyframeInterval == 0 || !readInt(in, pos, keyframeCount, 4)) return false;
+        // Each keyframe takes at least its two sizes
+        if (keyframeCount > tickCount / keyframeInterval + 1 || (in.size() - pos) / 8 < keyframeCount) return false;
+        keyframes.assign(keyframeCount, Keyframe());
+        for (auto& key : keyframes) {
+            sf::Uint32 packedSize;
+            if (!readInt(in, pos, key.rawSize, 4) || key.rawSize > GameConfig::REPLAY_KEYFRAME_MAX_BYTES ||
+                !readInt(in, pos, packedSize, 4) || pos + packedSize > in.size()) return false;
+            key.packed.assign(in.begin() + pos, in.begin() + pos + packedSize);
+            pos += packedSize;
+        }
+        return true;
+    }
+
+private:
+    // Keyframes are mostly small integers and flags, so they are packed as
+    // alternating (varint zero-run length, varint literal length, literal bytes).
+    static void pack(const std::vector<sf::Uint8>& raw, std::vector<sf::Uint8>& packed) {
+        packed.clear();
+        size_t i = 0;
+        while (i < raw.size()) {
+            size_t zeroStart = i;
+            while (i < raw.size() && raw[i] == 0) i++;
+            size_t literalStart = i;
+            // A literal run ends at the first pair of zero bytes
+            while (i < raw.size() && !(raw[i] == 0 && (i + 1 == raw.size() || raw[i + 1] == 0))) i++;
+            writeVarint(packed, static_cast<sf::Uint32>(literalStart - zeroStart));
+            writeVarint(packed, static_cast<sf::Uint32>(i - literalStart));
+            packed.insert(packed.end(), raw.begin() + literalStart, raw.begin() + i);
+        }
+    }
+    static bool unpack(const std::vector<sf::Uint8>& packed, sf::Uint32 rawSize, std::vector<sf::Uint8>& raw) {
+        raw.clear();
+        size_t pos = 0;
+        while (pos < packed.size()) {
+            sf::Uint32 zeros, literals;
+            if (!readVarint(packed, pos, zeros) || !readVarint(packed, pos, literals) || pos + literals > packed.size()) return false;
+            if (zeros > rawSize - raw.size() || literals > rawSize - raw.size() - zeros) return false;
+            raw.insert(raw.end(), zeros, 0);
+            raw.insert(raw.end(), packed.begin() + pos, packed.begin() + pos + literals);
+            pos += literals;
+        }
+        return raw.size() == rawSize;
+    }
+
+    static void writeInt(std::vector<sf::Uint8>& out, sf::Uint32 value, int bytes) {
+        for (int i = 0; i < bytes; ++i)
+            out.push_back(static_cast<sf::Uint8>(value >> (8 * i)));
+    }
+    static void writeVarint(std::vector<sf::Uint8>& out, sf::Uint32 value) {
+        while (value >= 0x80) {
+            out.push_back(static_cast<sf::Uint8>(value | 0x80));
+            value >>= 7;
+        }
+        out.push_back(static_cast<sf::Uint8>(value));
+    }
+    static bool readInt(const std::vector<sf::Uint8>& in, size_t& pos, sf::Uint32& value, int bytes) {
+        if (pos + bytes > in.size()) return false;
+        value = 0;
+        for (int i = 0; i < bytes; ++i)
+            value |= static_cast<sf::Uint32>(in[pos++]) << (8 * i);
+        return true;
+    }
+    static bool readVarint(const std::vector<sf::Uint8>& in, size_t& pos, sf::Uint32& value) {
+        value = 0;
+        for (int shift = 0; shift < 35; shift += 7) {
+            if (pos >= in.size()) return false;
+            sf::Uint8 byte = in[pos++];
+            value |= static_cast<sf::Uint32>(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) return true;
+        }
+        return false;
+    }
+};
+
+// Steps through a replay's runs one tick at a time.
+class ReplayCursor {
+public:
+    explicit ReplayCursor(const Replay& r) : replay(&r) {}
+    bool finished() const { return runIndex >= replay->runs.size(); }
+    InputFrame next() {
+        InputFrame f;
+        if (finished()) return f;
+        f.bits = replay->runs[runIndex].bits;
+        if (++runOffset >= replay->runs[runIndex].length) {
+            runIndex++;
+            runOffset = 0;
+        }
+        return f;
+    }
+    // Positions the cursor so the next input returned is the one for the given tick.
+    void seek(sf::Uint64 tick) {
+        runIndex = 0;
+        runOffset = 0;
+        while (runIndex < replay->runs.size() && tick >= replay->runs[runIndex].length) {
+            tick -= replay->runs[runIndex].length;
+            runIndex++;
+        }
+        if (runIndex < replay->runs.size())
+            runOffset = static_cast<sf::Uint32>(tick);
+    }
+private:
+    const Replay* replay;
+    size_t runIndex = 0;
+    sf::Uint32 runOffset = 0;
+};
+
+// How the game was launched from the command line.
+struct LaunchOptions {
+    enum Mode { PLAY, RECORD, REPLAY };
+    Mode mode = PLAY;
+    std::string replayFile;
+    bool headless = false;
+    float seekSeconds = 0.f;
+    float timeScale = 1.f;
+    bool fixedPoint = false;
+    // Self-checks on their own, or snapshot round trips during a headless replay
+    bool check = false;
+    // Broadphase for bullets against enemies. AUTO is the quadtree, which measured
+    // fastest on recorded games at every level; the others are for comparison.
+    enum Broadphase { AUTO, GRID, SORT_AND_SWEEP, QUADTREE };
+    Broadphase broadphase = AUTO;
+
+    Broadphase enemyBroadphase() const { return broadphase == AUTO ? QUADTREE : broadphase; }
+
+    static const char* nameOf(Broadphase b) {
+        return b == GRID ? "grid" : b == SORT_AND_SWEEP ? "sort-and-sweep" : b == QUADTREE ? "quadtree" : "auto";
+    }
+};
+
+// --- Game Entities  ---
+// Entities share their animation frames with the game instead of owning copies,
+// which keeps them cheap to create and to rebuild from a keyframe.
+class Bullet {
+public:
+    const std::vector<sf::Texture>* frames;
+    sf::Sprite sprite;
+    int currentFrame = 0;
+    GameClock frameClock;
+    sf::Vector2f velocity = { 0.f, GameConfig::BULLET_MOVE_SPEED };
+    sf::Vector2f previousPosition; // where this tick's move started
+    FixedPosition fixedPosition;
+    Aabb bounds;
+    StateHash::Share stateHash; // of the State record past its position; see StateHash
+    Bullet(const std::vector<sf::Texture>& bulletFrames, sf::Vector2f position) : frames(&bulletFrames) {
+        sprite.setTexture((*frames)[0]);
+        fixedPosition.set(sprite, bounds, position);
+        previousPosition = position;
+    }
+    Bullet(const std::vector<sf::Texture>& bulletFrames, sf::Vector2f position, sf::Vector2f vel) : frames(&bulletFrames) {
+        sprite.setTexture((*frames)[0]);
+        fixedPosition.set(sprite, bounds, position);
+        previousPosition = position;
+        velocity = vel;
+        fitBounds();
+    }
+    void update() {
+        if (frameClock.getElapsedTime().asMilliseconds() > GameConfig::BULLET_ANIMATION_INTERVAL_MS) {
+            currentFrame = (currentFrame + 1) % frames->size();
+            sprite.setTexture((*frames)[currentFrame]);
+            frameClock.restart();
+            stateHash.update(StateHash::of(*this));
+        }
+        previousPosition = sprite.getPosition();
+        fixedPosition.move(sprite, bounds, velocity);
+        fitBounds();
+    }
+
+    // A bullet flying straight up or down is upright and collides as its box.
+    // Any other is turned to its heading and collides as an oriented box, whose
+    // enclosing box then serves as its bounds.
+    bool oriented() const { return velocity.x != 0.f; }
+    Obb collider(sf::Vector2f back = sf::Vector2f()) const {
+        Obb o = Obb::of(Aabb::of(sprite), velocity);
+        o.center -= back;
+        return o;
+    }
+    // Degrees to draw it turned by
+    float rotation() const {
+        return oriented() ? std::atan2(velocity.y, velocity.x) * 180.f / 3.14159265f - 90.f : 0.f;
+    }
+
+    // This tick's move as a swept box, tested against targets where they stand
+    // at the end of the tick. A bullet moving straight along an axis by less
+    // than its own size cannot pass a target between two ticks, so it only tests
+    // where it ended up. Any other move, a fast one or a diagonal one that can
+    // clip a corner, finds the earliest point on its path that touches the
+    // target, without anything being sub-stepped.
+    struct Sweep {
+        Aabb bounds; // at the end of the move
+        sf::Vector2f moved;
+        bool crosses; // can touch a target its end position misses
+
+        static Sweep of(const Aabb& bounds, sf::Vector2f moved) {
+            Sweep s;
+            s.bounds = bounds;
+            s.moved = moved;
+            s.crosses = (moved.x != 0.f && moved.y != 0.f) ||
+                std::abs(moved.x) > std::max(bounds.width(), 1.f) || std::abs(moved.y) > std::max(bounds.height(), 1.f);
+            return s;
+        }
+
+        // Earliest time in (0, 1] of this tick at which the box overlaps the target
+        // and 'exact' agrees, or -1 if it never does. 'exact' is given how far the
+        // box is behind the end of the move. Like CollisionMask::overlap it may round
+        // the offset between the boxes' corners to whole pixels, so the time the
+        // boxes overlap is split wherever that rounded offset changes, and 'exact'
+        // is asked once per piece, in its middle, which is the time returned. No
+        // finer test can be stepped over, and a turned bullet's test is still
+        // asked at least once per pixel travelled on either axis.
+        template <typename F>
+        float timeOfImpact(const Aabb& target, F exact) const {
+            if (!crosses)
+                return bounds.intersects(target) && exact(sf::Vector2f()) ? 1.f : -1.f;
+            float enter = -std::numeric_limits<float>::infinity(), exit = std::numeric_limits<float>::infinity();
+            if (!overlapTimes(bounds.left - moved.x, bounds.right - moved.x, moved.x, target.left, target.right, enter, exit) ||
+                !overlapTimes(bounds.top - moved.y, bounds.bottom - moved.y, moved.y, target.top, target.bottom, enter, exit))
+                return -1.f;
+            const float from = std::max(enter, 0.f), to = std::min(exit, 1.f);
+            if (from >= to || enter >= 1.f)
+                return -1.f;
+            const float speedX = std::abs(moved.x), speedY = std::abs(moved.y);
+            const float firstX = firstCrossing(target.left - bounds.left + moved.x * (1.f - from), moved.x);
+            const float firstY = firstCrossing(target.top - bounds.top + moved.y * (1.f - from), moved.y);
+            int crossedX = 0, crossedY = 0;
+            for (float start = from; start < to;) {
+                const float nextX = speedX > 0.f ? from + (firstX + crossedX) / speedX : to;
+                const float nextY = speedY > 0.f ? from + (firstY + crossedY) / speedY : to;
+                const float end = std::min(std::min(nextX, nextY), to);
+                const float t = (start + end) * 0.5f;
+                if (end > start && exact(moved * (1.f - t)))
+                    return t;
+                crossedX += nextX <= end;
+                crossedY += nextY <= end;
+                start = end;
+            }
+            return -1.f;
+        }
+        template <typename F>
+        bool hits(const Aabb& target, F exact) const { return timeOfImpact(target, exact) >= 0.f; }
+        bool hits(const Aabb& target) const { return hits(target, [](sf::Vector2f) { return true; }); }
+        // Everything the box passes over this tick
+        Aabb area() const {
+            Aabb a = bounds;
+            a.left -= std::max(moved.x, 0.f);
+            a.right -= std::min(moved.x, 0.f);
+            a.top -= std::max(moved.y, 0.f);
+            a.bottom -= std::min(moved.y, 0.f);
+            return a;
+        }
+
+    private:
+        // How many pixels 'offset' moves, shrinking by 'move' per tick, before it
+        // next crosses a half pixel, where its rounding changes
+        static float firstCrossing(float offset, float move) {
+            const float h = offset - 0.5f;
+            const float d = move > 0.f ? h - std::floor(h) : std::ceil(h) - h;
+            return d > 0.f ? d : 1.f;
+        }
+        // Narrows [enter, exit] to the open interval in which the span lo..hi,
+        // moving by 'move' per tick, overlaps targetLo..targetHi. False if it never does.
+        static bool overlapTimes(float lo, float hi, float move, float targetLo, float targetHi, float& enter, float& exit) {
+            if (move == 0.f)
+                return lo < targetHi && targetLo < hi;
+            float a = (targetLo - hi) / move, b = (targetHi - lo) / move;
+            if (move < 0.f)
+                std::swap(a, b);
+            enter = std::max(enter, a);
+            exit = std::min(exit, b);
+            return true;
+        }
+    };
+    Sweep sweep() const { return Sweep::of(bounds, sprite.getPosition() - previousPosition); }
+    bool hits(const Aabb& target) const { return sweep().hits(target); }
+
+    // Snapshot record; see GameSnapshot
+    struct alignas(8) State {
+        static constexpr int POSITION_WORDS = 2; // x, y and fx, fy; see StateHash
+        float x, y;
+        sf::Int32 fx, fy; // fixed-point position
+        sf::Uint64 frameClockStart;
+        float vx, vy;
+        sf::Int32 currentFrame;
+    };
+    void saveState(State& s) const {
+        s.frameClockStart = frameClock.getStartTick();
+        s.x = sprite.getPosition().x;
+        s.y = sprite.getPosition().y;
+        s.vx = velocity.x;
+        s.vy = velocity.y;
+        s.fx = fixedPosition.x;
+        s.fy = fixedPosition.y;
+        s.currentFrame = currentFrame;
+    }
+    void loadState(const State& s) {
+        frameClock.setStartTick(s.frameClockStart);
+        sprite.setPosition(s.x, s.y);
+        bounds = Aabb::of(sprite);
+        fixedPosition.x = s.fx;
+        fixedPosition.y = s.fy;
+        previousPosition = sprite.getPosition();
+        velocity = sf::Vector2f(s.vx, s.vy);
+        currentFrame = s.currentFrame;
+        sprite.setTexture((*frames)[currentFrame % frames->size()]);
+        fitBounds();
+    }
+
+private:
+    void fitBounds() {
+        if (oriented())
+            bounds = collider().bounds();
+    }
+};
+
+class Enemy {
+public:
+    sf::Sprite sprite;
+    FixedPosition fixedPosition;
+    Aabb bounds;
+    StateHash::Share stateHash;
+    float speed;
+    Enemy(const sf::Texture& texture, sf::Vector2f position) {
+        sprite.setTexture(texture);
+        fixedPosition.set(sprite, bounds, position);
+        speed = GameConfig::ENEMY_SPEED_LEVEL1;
+    }
+    virtual void update() { fixedPosition.move(sprite, bounds, sf::Vector2f(0.f, speed)); }
+
+    // Snapshot record shared by every enemy type; animated says which type to rebuild
+    struct alignas(8) State {
+        static constexpr int POSITION_WORDS = 2; // x, y and fx, fy; see StateHash
+        float x, y;
+        sf::Int32 fx, fy;
+        sf::Uint64 frameClockStart;
+        float speed;
+        sf::Int32 animated, currentFrame;
+    };
+    virtual void saveState(State& s) const {
+        s.frameClockStart = 0;
+        s.x = sprite.getPosition().x;
+        s.y = sprite.getPosition().y;
+        s.speed = speed;
+        s.fx = fixedPosition.x;
+        s.fy = fixedPosition.y;
+        s.animated = 0;
+        s.currentFrame = 0;
+    }
+    virtual void loadState(const State& s) {
+        sprite.setPosition(s.x, s.y);
+        bounds = Aabb::of(sprite);
+        fixedPosition.x = s.fx;
+        fixedPosition.y = s.fy;
+        speed = s.speed;
+    }
+    virtual ~Enemy() {}
+};
+
+class AnimatedEnemy : public Enemy {
+public:
+    const std::vector<sf::Texture>* frames;
+    int currentFrame = 0;
+    GameClock frameClock;
+    AnimatedEnemy(const std::vector<sf::Texture>& enemyFrames, sf::Vector2f position, float spd)
+        : Enemy(enemyFrames[0], position), frames(&enemyFrames) {
+        speed = spd;
+        sprite.setTexture((*frames)[0]);
+    }
+    void update() override {
+        if (frameClock.getElapsedTime().asMilliseconds() > 100) {
+            currentFrame = (currentFrame + 1) % frames->size();
+            sprite.setTexture((*frames)[currentFrame]);
+            frameClock.restart();
+            stateHash.update(StateHash::of(*this));
+        }
+        fixedPosition.move(sprite, bounds, sf::Vector2f(0.f, speed));
+    }
+    void saveState(State& s) const override {
+        Enemy::saveState(s);
+        s.frameClockStart = frameClock.getStartTick();
+        s.animated = 1;
+        s.currentFrame = currentFrame;
+    }
+    void loadState(const State& s) override {
+        Enemy::loadState(s);
+        frameClock.setStartTick(s.frameClockStart);
+        currentFrame = s.currentFrame;
+        sprite.setTexture((*frames)[currentFrame % frames->size()]);
+    }
+};
+
+class Explosion {
+public:
+    const std::vector<sf::Texture>* frames;
+    sf::Sprite sprite;
+    int currentFrame = 0;
+    GameClock frameClock;
+    bool finished = false;
+    StateHash::Share stateHash;
+    Explosion(const std::vector<sf::Texture>& explosionFrames, const sf::Vector2f& position) : frames(&explosionFrames) {
+        sprite.setTexture((*frames)[0]);
+        sprite.setPosition(position);
+    }
+    void update() {
+        if (frameClock.getElapsedTime().asMilliseconds() > GameConfig::EXPLOSION_ANIMATION_INTERVAL_MS) {
+            currentFrame++;
+            if (currentFrame < frames->size()) {
+                sprite.setTexture((*frames)[currentFrame]);
+                frameClock.restart();
+            }
+            else {
+                finished = true;
+            }
+            stateHash.update(StateHash::of(*this));
+        }
+    }
+
+    struct alignas(8) State {
+        static constexpr int POSITION_WORDS = 0; // explosions stay put
+        sf::Uint64 frameClockStart;
+        float x, y;
+        sf::Int32 currentFrame, finished;
+    };
+    void saveState(State& s) const {
+        s.frameClockStart = frameClock.getStartTick();
+        s.x = sprite.getPosition().x;
+        s.y = sprite.getPosition().y;
+        s.currentFrame = currentFrame;
+        s.finished = finished;
+    }
+    void loadState(const State& s) {
+        frameClock.setStartTick(s.frameClockStart);
+        sprite.setPosition(s.x, s.y);
+        currentFrame = s.currentFrame;
+        finished = s.finished != 0;
+        sprite.setTexture((*frames)[std::min<size_t>(currentFrame, frames->size() - 1)]);
+    }
+};
+
+class Boss {
+public:
+    const std::vector<sf::Texture>* frames = nullptr;
+    sf::Sprite sprite;
+    int currentFrame = 0;
+    GameClock animationClock;
+    float moveSpeed = GameConfig::BOSS_MOVE_SPEED;
+    int direction = 1;
+    int health = GameConfig::BOSS_MAX_HEALTH;
+    enum Phase { PHASE1, PHASE2, PHASE3 };
+    Phase phase = PHASE1;
+    FixedPosition fixedPosition;
+    Aabb bounds;
+    StateHash::Share stateHash;
+    Boss() {
+        fixedPosition.set(sprite, bounds, sf::Vector2f(300.f, -100.f));
+    }
+    explicit Boss(const std::vector<sf::Texture>& bossFrames) : frames(&bossFrames) {
+        sprite.setTexture((*frames)[0]);
+        fixedPosition.set(sprite, bounds, sf::Vector2f(300.f, -100.f));
+    }
+    void update() {
+        if (animationClock.getElapsedTime().asMilliseconds() > 100) {
+            currentFrame = (currentFrame + 1) % frames->size();
+            sprite.setTexture((*frames)[currentFrame]);
+            animationClock.restart();
+            stateHash.update(StateHash::of(*this));
+        }
+        fixedPosition.move(sprite, bounds, sf::Vector2f(moveSpeed * direction, 0.f));
+        if (bounds.left <= 0 || bounds.right >= GameConfig::WINDOW_WIDTH) {
+            direction *= -1;
+            stateHash.update(StateHash::of(*this));
+        }
+    }
+    void updatePhase() {
+        Phase previous = phase;
+        if (health <= GameConfig::BOSS_PHASE3_HP)
+            phase = PHASE3;
+        else if (health <= GameConfig::BOSS_PHASE2_HP)
+            phase = PHASE2;
+        else
+            phase = PHASE1;
+        if (phase != previous)
+            stateHash.update(StateHash::of(*this));
+    }
+
+    struct alignas(8) State {
+        static constexpr int POSITION_WORDS = 2; // x, y and fx, fy; see StateHash
+        float x, y;
+        sf::Int32 fx, fy;
+        sf::Uint64 animationClockStart;
+        float moveSpeed;
+        sf::Int32 currentFrame, direction, health, phase;
+    };
+    void saveState(State& s) const {
+        s.animationClockStart = animationClock.getStartTick();
+        s.x = sprite.getPosition().x;
+        s.y = sprite.getPosition().y;
+        s.moveSpeed = moveSpeed;
+        s.fx = fixedPosition.x;
+        s.fy = fixedPosition.y;
+        s.currentFrame = currentFrame;
+        s.direction = direction;
+        s.health = health;
+        s.phase = phase;
+    }
+    void loadState(const State& s) {
+        animationClock.setStartTick(s.animationClockStart);
+        sprite.setPosition(s.x, s.y);
+        bounds = Aabb::of(sprite);
+        fixedPosition.x = s.fx;
+        fixedPosition.y = s.fy;
+        moveSpeed = s.moveSpeed;
+        currentFrame = s.currentFrame;
+        direction = s.direction;
+        health = s.health;
+        phase = static_cast<Phase>(s.phase);
+        if (frames)
+            sprite.setTexture((*frames)[currentFrame % frames->size()]);
+    }
+};
+
+// --- Health PowerUp Entity ---
+class HealthPowerUp {
+public:
+    sf::Sprite sprite;
+    FixedPosition fixedPosition;
+    Aabb bounds;
+    StateHash::Share stateHash;
+    float speed;
+    bool active;
+    HealthPowerUp(const sf::Texture& tex, sf::Vector2f pos, float spd)
+        : speed(spd), active(true)
+    {
+        sprite.setTexture(tex);
+        fixedPosition.set(sprite, bounds, pos);
+    }
+    void update() {
+        fixedPosition.move(sprite, bounds, sf::Vector2f(0.f, speed));
+        if (sprite.getPosition().y > GameConfig::WINDOW_HEIGHT) {
+            active = false;
+            stateHash.update(StateHash::of(*this));
+        }
+    }
+
+    struct alignas(8) State {
+        static constexpr int POSITION_WORDS = 2; // x, y and fx, fy; see StateHash
+        float x, y;
+        sf::Int32 fx, fy;
+        float speed;
+        sf::Int32 active;
+    };
+    void saveState(State& s) const {
+        s.x = sprite.getPosition().x;
+        s.y = sprite.getPosition().y;
+        s.speed = speed;
+        s.fx = fixedPosition.x;
+        s.fy = fixedPosition.y;
+        s.active = active;
+    }
+    void loadState(const State& s) {
+        sprite.setPosition(s.x, s.y);
+        bounds = Aabb::of(sprite);
+        fixedPosition.x = s.fx;
+        fixedPosition.y = s.fy;
+        speed = s.speed;
+        active = s.active != 0;
+    }
+};
+
+// --- Game Snapshots ---
+// The whole simulation state in one flat, reusable buffer: a fixed header followed
+// by arrays of per-entity POD records. Saving and restoring are plain field copies,
+// and a snapshot that is reused every frame stops allocating once it has grown to
+// the largest entity counts seen. The layout is native, like the rest of the replay.
+class GameSnapshot {
+public:
+    struct alignas(8) Header {
+        sf::Uint64 tick;
+        sf::Uint64 rngState, rngInc;
+        sf::Uint64 bossAttackClock, bossSpreadAttackClock, bossMinionSpawnClock;
+        sf::Uint64 enemySpawnClock, shootClock, shakeClock, levelTransitionClock, gameTimer, healthPowerUpClock;
+        Boss::State boss;
+        float playerX, playerY;
+        float shakeDuration, level2EnemySpeed, level2SpawnRate, timeSurvived;
+        float healthPowerUpTimer, healthPowerUpNextSpawn;
+        sf::Int32 gameState, health, score, level, bossHealth, nextLevel;
+        sf::Int32 level2DoubleSpawnCounter, level2MaxEnemies, totalKills;
+        sf::Int32 bossSpawned, bossDefeated, isShaking, inLevelTransition, bossMusicStarted;
+        sf::Int32 level1CompleteSoundPlayed, level2CompleteSoundPlayed, gameOverSoundPlayed, gameOverScoreSaved;
+        sf::Uint32 bulletCount, enemyCount, explosionCount, bossBulletCount, healthPowerUpCount;
+    };
+
+    std::vector<sf::Uint8> data;
+
+    // Sizes the buffer for the given entity counts and zeroes it, so padding bytes
+    // never make two equal states compare different.
+    void prepare(size_t bullets, size_t enemies, size_t explosions, size_t bossBullets, size_t healthPowerUps) {
+        data.assign(sizeof(Header) + bullets * sizeof(Bullet::State) + enemies * sizeof(Enemy::State) +
+            explosions * sizeof(Explosion::State) + bossBullets * sizeof(Bullet::State) +
+            healthPowerUps * sizeof(HealthPowerUp::State), 0);
+        Header& h = header();
+        h.bulletCount = static_cast<sf::Uint32>(bullets);
+        h.enemyCount = static_cast<sf::Uint32>(enemies);
+        h.explosionCount = static_cast<sf::Uint32>(explosions);
+        h.bossBulletCount = static_cast<sf::Uint32>(bossBullets);
+        h.healthPowerUpCount = static_cast<sf::Uint32>(healthPowerUps);
+    }
+
+    // True if the buffer holds a header whose entity counts match its size.
+    bool isValid() const {
+        return data.size() >= sizeof(Header) && data.size() == healthPowerUpsOffset() + header().healthPowerUpCount * sizeof(HealthPowerUp::State);
+    }
+
+    bool operator==(const GameSnapshot& other) const { return data == other.data; }
+
+    Header& header() { return *reinterpret_cast<Header*>(data.data()); }
+    const Header& header() const { return *reinterpret_cast<const Header*>(data.data()); }
+    Bullet::State* bullets() { return reinterpret_cast<Bullet::State*>(data.data() + bulletsOffset()); }
+    const Bullet::State* bullets() const { return reinterpret_cast<const Bullet::State*>(data.data() + bulletsOffset()); }
+    Enemy::State* enemies() { return reinterpret_cast<Enemy::State*>(data.data() + enemiesOffset()); }
+    const Enemy::State* enemies() const { return reinterpret_cast<const Enemy::State*>(data.data() + enemiesOffset()); }
+    Explosion::State* explosions() { return reinterpret_cast<Explosion::State*>(data.data() + explosionsOffset()); }
+    const Explosion::State* explosions() const { return reinterpret_cast<const Explosion::State*>(data.data() + explosionsOffset()); }
+    Bullet::State* bossBullets() { return reinterpret_cast<Bullet::State*>(data.data() + bossBulletsOffset()); }
+    const Bullet::State* bossBullets() const { return reinterpret_cast<const Bullet::State*>(data.data() + bossBulletsOffset()); }
+    HealthPowerUp::State* healthPowerUps() { return reinterpret_cast<HealthPowerUp::State*>(data.data() + healthPowerUpsOffset()); }
+    const HealthPowerUp::State* healthPowerUps() const { return reinterpret_cast<const HealthPowerUp::State*>(data.data() + healthPowerUpsOffset()); }
+
+    // Writes one line per differing field or entity list and returns how many there were.
+    static int diff(const GameSnapshot& a, const GameSnapshot& b, std::ostream& out) {
+        int differences = 0;
+        auto field = [&](const char* name, const auto& va, const auto& vb) {
+            if (std::memcmp(&va, &vb, sizeof(va)) != 0) {
+                out << "  " << name << ": " << va << " -> " << vb << "\n";
+                differences++;
+            }
+        };
+        auto records = [&](const char* name, const void* ra, sf::Uint32 countA, const void* rb, sf::Uint32 countB, size_t size) {
+            if (countA != countB) {
+                out << "  " << name << " count: " << countA << " -> " << countB << "\n";
+                differences++;
+                return;
+            }
+            sf::Uint32 changed = 0, first = 0;
+            for (sf::Uint32 i = 0; i < countA; ++i) {
+                if (std::memcmp(static_cast<const sf::Uint8*>(ra) + i * size, static_cast<const sf::Uint8*>(rb) + i * size, size) != 0) {
+                    if (changed == 0) first = i;
+                    changed++;
+                }
+            }
+            if (changed > 0) {
+                out << "  " << name << ": " << changed << " of " << countA << " changed, first [" << first << "]\n";
+                differences++;
+            }
+        };
+        const Header& ha = a.header();
+        const Header& hb = b.header();
+        field("tick", ha.tick, hb.tick);
+        field("rngState", ha.rngState, hb.rngState);
+        field("rngInc", ha.rngInc, hb.rngInc);
+        field("bossAttackClock", ha.bossAttackClock, hb.bossAttackClock);
+        field("bossSpreadAttackClock", ha.bossSpreadAttackClock, hb.bossSpreadAttackClock);
+        field("bossMinionSpawnClock", ha.bossMinionSpawnClock, hb.bossMinionSpawnClock);
+        field("enemySpawnClock", ha.enemySpawnClock, hb.enemySpawnClock);
+        field("shootClock", ha.shootClock, hb.shootClock);
+        field("shakeClock", ha.shakeClock, hb.shakeClock);
+        field("levelTransitionClock", ha.levelTransitionClock, hb.levelTransitionClock);
+        field("gameTimer", ha.gameTimer, hb.gameTimer);
+        field("healthPowerUpClock", ha.healthPowerUpClock, hb.healthPowerUpClock);
+        field("playerX", ha.playerX, hb.playerX);
+        field("playerY", ha.playerY, hb.playerY);
+        field("shakeDuration", ha.shakeDuration, hb.shakeDuration);
+        field("level2EnemySpeed", ha.level2EnemySpeed, hb.level2EnemySpeed);
+        field("level2SpawnRate", ha.level2SpawnRate, hb.level2SpawnRate);
+        field("timeSurvived", ha.timeSurvived, hb.timeSurvived);
+        field("healthPowerUpTimer", ha.healthPowerUpTimer, hb.healthPowerUpTimer);
+        field("healthPowerUpNextSpawn", ha.healthPowerUpNextSpawn, hb.healthPowerUpNextSpawn);
+        field("gameState", ha.gameState, hb.gameState);
+        field("health", ha.health, hb.health);
+        field("score", ha.score, hb.score);
+        field("level", ha.level, hb.level);
+        field("bossHealth", ha.bossHealth, hb.bossHealth);
+        field("nextLevel", ha.nextLevel, hb.nextLevel);
+        field("level2DoubleSpawnCounter", ha.level2DoubleSpawnCounter, hb.level2DoubleSpawnCounter);
+        field("level2MaxEnemies", ha.level2MaxEnemies, hb.level2MaxEnemies);
+        field("totalKills", ha.totalKills, hb.totalKills);
+        field("bossSpawned", ha.bossSpawned, hb.bossSpawned);
+        field("bossDefeated", ha.bossDefeated, hb.bossDefeated);
+        field("isShaking", ha.isShaking, hb.isShaking);
+        field("inLevelTransition", ha.inLevelTransition, hb.inLevelTransition);
+        field("bossMusicStarted", ha.bossMusicStarted, hb.bossMusicStarted);
+        field("level1CompleteSoundPlayed", ha.level1CompleteSoundPlayed, hb.level1CompleteSoundPlayed);
+        field("level2CompleteSoundPlayed", ha.level2CompleteSoundPlayed, hb.level2CompleteSoundPlayed);
+        field("gameOverSoundPlayed", ha.gameOverSoundPlayed, hb.gameOverSoundPlayed);
+        field("gameOverScoreSaved", ha.gameOverScoreSaved, hb.gameOverScoreSaved);
+        records("boss", &ha.boss, 1, &hb.boss, 1, sizeof(Boss::State));
+        records("bullets", a.bullets(), ha.bulletCount, b.bullets(), hb.bulletCount, sizeof(Bullet::State));
+        records("enemies", a.enemies(), ha.enemyCount, b.enemies(), hb.enemyCount, sizeof(Enemy::State));
+        records("explosions", a.explosions(), ha.explosionCount, b.explosions(), hb.explosionCount, sizeof(Explosion::State));
+        records("bossBullets", a.bossBullets(), ha.bossBulletCount, b.bossBullets(), hb.bossBulletCount, sizeof(Bullet::State));
+        records("healthPowerUps", a.healthPowerUps(), ha.healthPowerUpCount, b.healthPowerUps(), hb.healthPowerUpCount, sizeof(HealthPowerUp::State));
+        return differences;
+    }
+
+private:
+    size_t bulletsOffset() const { return sizeof(Header); }
+    size_t enemiesOffset() const { return bulletsOffset() + header().bulletCount * sizeof(Bullet::State); }
+    size_t explosionsOffset() const { return enemiesOffset() + header().enemyCount * sizeof(Enemy::State); }
+    size_t bossBulletsOffset() const { return explosionsOffset() + header().explosionCount * sizeof(Explosion::State); }
+    size_t healthPowerUpsOffset() const { return bossBulletsOffset() + header().bossBulletCount * sizeof(Bullet::State); }
+};
+
+// --- Render Frames ---
+// One sprite to draw: the texture it shows and where.
+struct SpriteInstance {
+    const sf::Texture* texture;
+    sf::Vector2f position;
+    float rotation = 0.f; // degrees clockwise about the texture's center
+    sf::Vector2f scale = sf::Vector2f(1.f, 1.f);
+};
+
+// Immutable picture of the game for one frame. The simulation thread fills it,
+// the render thread only reads it. Vectors keep their capacity between frames.
+struct RenderFrame {
+    sf::Uint64 tick = 0;
+    int gameState = 0;
+    sf::Vector2f viewOffset; // camera shake
+    SpriteInstance player = { nullptr, sf::Vector2f() };
+    std::vector<SpriteInstance> sprites; // entities, player excluded
+    std::vector<SpriteInstance> effects; // drawn above every entity
+    int score = 0, level = 1, highScore = 0, totalKills = 0;
+    int health = GameConfig::PLAYER_MAX_HEALTH;
+    int bossHealth = GameConfig::BOSS_MAX_HEALTH;
+    bool showBossHealth = false;
+    float timeSurvived = 0.f;
+    float timeScale = 1.f;
+    bool paused = false;
+};
+
+// Lock-free single producer / single consumer triple buffer. The writer and the
+// reader each own one slot and the third is swapped between them atomically,
+// so neither side ever waits for the other and the reader always gets the newest frame.
+template <typename T>
+class TripleBuffer {
+public:
+    TripleBuffer() : writeIndex(0), readIndex(1), shared(2) {}
+
+    T& writeSlot() { return slots[writeIndex]; }
+    const T& readSlot() const { return slots[readIndex]; }
+
+    // Hands the filled write slot over to the reader.
+    void publish() {
+        writeIndex = shared.exchange(writeIndex | FRESH, std::memory_order_acq_rel) & INDEX_MASK;
+    }
+
+    // Takes the newest published slot; false if nothing was published since the last fetch.
+    bool fetch() {
+        if (!(shared.load(std::memory_order_relaxed) & FRESH))
+            return false;
+        readIndex = shared.exchange(readIndex, std::memory_order_acq_rel) & INDEX_MASK;
+        return true;
+    }
+
+private:
+    enum { INDEX_MASK = 3, FRESH = 4 };
+    T slots[3];
+    int writeIndex, readIndex;
+    std::atomic<int> shared;
+};
+
+// --- Sprite Batching ---
+// Packs the sprite textures into one, so sprites showing different animation
+// frames can still be drawn together. Tallest first, in rows left to right.
+class TextureAtlas {
+public:
+    void add(const sf::Texture& texture) { pending.push_back(&texture); }
+    void add(const std::vector<sf::Texture>& textures) {
+        for (const auto& texture : textures)
+            add(texture);
+    }
+
+    // Copies every added texture in. If they don't fit, nothing is mapped and
+    // sprites are batched by their own textures instead.
+    bool build() {
+        const int maxSize = static_cast<int>(sf::Texture::getMaximumSize());
+        const int width = std::min(GameConfig::ATLAS_WIDTH, maxSize);
+        const int pad = GameConfig::ATLAS_PADDING;
+        std::sort(pending.begin(), pending.end(), [](const sf::Texture* a, const sf::Texture* b) {
+            return a->getSize().y > b->getSize().y;
+        });
+        rects.clear();
+        int x = 0, y = 0, rowHeight = 0;
+        for (const sf::Texture* texture : pending) {
+            if (rects.count(texture))
+                continue;
+            const int w = static_cast<int>(texture->getSize().x), h = static_cast<int>(texture->getSize().y);
+            if (x + w + pad > width) {
+                x = 0;
+                y += rowHeight;
+                rowHeight = 0;
+            }
+            if (w + 2 * pad > width || y + h + 2 * pad > maxSize) {
+                rects.clear();
+                return false;
+            }
+            rects[texture] = sf::IntRect(x + pad, y + pad, w, h);
+            x += w + pad;
+            rowHeight = std::max(rowHeight, h + pad);
+        }
+        sf::Image image;
+        image.create(static_cast<unsigned>(width), static_cast<unsigned>(y + rowHeight + pad), sf::Color::Transparent);
+        for (const auto& entry : rects)
+            image.copy(entry.first->copyToImage(), entry.second.left, entry.second.top);
+        if (!atlas.loadFromImage(image)) {
+            rects.clear();
+            return false;
+        }
+        return true;
+    }
+
+    const sf::Texture& texture() const { return atlas; }
+
+    // Where a texture was packed, or null if it wasn't.
+    const sf::IntRect* find(const sf::Texture* texture) const {
+        auto it = rects.find(texture);
+        return it != rects.end() ? &it->second : nullptr;
+    }
+
+private:
+    std::vector<const sf::Texture*> pending;
+    std::unordered_map<const sf::Texture*, sf::IntRect> rects;
+    sf::Texture atlas;
+};
+
+// What one frame cost to submit.
+struct RenderStats {
+    int drawCalls = 0;
+    int batches = 0;
+    int vertices = 0; // batched quads only
+};
+
+// Collects textured quads in one vertex array and draws each run that uses the
+// same texture with a single call. Sprites keep their order, so overlaps look
+// the same as drawing them one by one.
+class SpriteBatch {
+public:
+    explicit SpriteBatch(const TextureAtlas& atlas) : atlas(atlas), vertices(sf::Triangles) {}
+
+    // The texture a sprite is actually drawn from: the atlas if it was packed.
+    const sf::Texture* textureFor(const sf::Texture* texture) const {
+        return atlas.find(texture) ? &atlas.texture() : texture;
+    }
+
+    void add(const SpriteInstance& s) {
+        if (!s.texture)
+            return;
+        const sf::IntRect* packed = atlas.find(s.texture);
+        const sf::Texture* texture = packed ? &atlas.texture() : s.texture;
+        const sf::IntRect source = packed ? *packed : sf::IntRect(sf::Vector2i(), sf::Vector2i(s.texture->getSize()));
+        if (runs.empty() || runs.back().texture != texture)
+            runs.push_back({ texture, vertices.getVertexCount(), 0 });
+
+        const sf::Vector2f size(source.width * s.scale.x, source.height * s.scale.y);
+        sf::Vector2f corners[4] = { s.position, s.position + sf::Vector2f(size.x, 0.f), s.position + size, s.position + sf::Vector2f(0.f, size.y) };
+        if (s.rotation != 0.f) {
+            const float radians = s.rotation * 3.14159265f / 180.f;
+            const float c = std::cos(radians), sn = std::sin(radians);
+            const sf::Vector2f center = s.position + size * 0.5f;
+            for (auto& corner : corners) {
+                const sf::Vector2f d = corner - center;
+                corner = center + sf::Vector2f(d.x * c - d.y * sn, d.x * sn + d.y * c);
+            }
+        }
+        const float left = static_cast<float>(source.left), top = static_cast<float>(source.top);
+        const float right = left + source.width, bottom = top + source.height;
+        const sf::Vector2f uv[4] = { { left, top }, { right, top }, { right, bottom }, { left, bottom } };
+        static const int TRIANGLES[6] = { 0, 1, 2, 0, 2, 3 };
+        for (int i : TRIANGLES)
+            vertices.append(sf::Vertex(corners[i], uv[i]));
+        runs.back().count += 6;
+    }
+
+    // Draws everything added since the last flush.
+    void flush(sf::RenderTarget& target, RenderStats& stats) {
+        for (const Run& run : runs) {
+            target.draw(&vertices[run.first], run.count, sf::Triangles, sf::RenderStates(run.texture));
+            ++stats.drawCalls;
+            ++stats.batches;
+            stats.vertices += static_cast<int>(run.count);
+        }
+        runs.clear();
+        vertices.clear();
+    }
+
+private:
+    struct Run {
+        const sf::Texture* texture;
+        size_t first, count;
+    };
+    const TextureAtlas& atlas;
+    sf::VertexArray vertices;
+    std::vector<Run> runs;
+};
+
+// --- Render Queue ---
+// Everything drawn in a frame, in layers drawn back to front. Within a layer
+// items are ordered by the texture they bind, so items sharing one end up next
+// to each other and batch into a single draw; items on the same texture keep
+// the order they were submitted in.
+class RenderQueue {
+public:
+    enum Layer { BACKGROUND, ENTITIES, FX, HUD };
+
+    explicit RenderQueue(SpriteBatch& batch) : batch(batch) {}
+
+    void submit(Layer layer, const SpriteInstance& sprite) {
+        if (!sprite.texture)
+            return;
+        keys.push_back(key(layer, batch.textureFor(sprite.texture), static_cast<sf::Uint32>(sprites.size())));
+        sprites.push_back(sprite);
+    }
+
+    // Ready-made geometry, drawn as it is with one call.
+    void submit(Layer layer, const sf::VertexArray& vertices, const sf::Texture* texture) {
+        if (vertices.getVertexCount() == 0)
+            return;
+        keys.push_back(key(layer, texture, static_cast<sf::Uint32>(arrays.size()) | ARRAY_ITEM));
+        arrays.push_back({ &vertices, texture });
+    }
+
+    // Sorts, draws and empties the queue.
+    void draw(sf::RenderTarget& target, RenderStats& stats) {
+        sort();
+        for (sf::Uint64 k : keys) {
+            const sf::Uint32 item = static_cast<sf::Uint32>(k);
+            if (item & ARRAY_ITEM) {
+                batch.flush(target, stats);
+                const Geometry& geometry = arrays[item & ~ARRAY_ITEM];
+                target.draw(*geometry.vertices, sf::RenderStates(geometry.texture));
+                ++stats.drawCalls;
+                ++stats.batches;
+                stats.vertices += static_cast<int>(geometry.vertices->getVertexCount());
+            }
+            else {
+                batch.add(sprites[item]);
+            }
+        }
+        batch.flush(target, stats);
+        keys.clear();
+        sprites.clear();
+        arrays.clear();
+        textures.clear();
+    }
+
+private:
+    // Key layout: layer in bits 48-55, texture in bits 32-47, item in bits 0-31.
+    enum : sf::Uint32 { ARRAY_ITEM = 0x80000000u };
+
+    struct Geometry {
+        const sf::VertexArray* vertices;
+        const sf::Texture* texture;
+    };
+
+    sf::Uint64 key(Layer layer, const sf::Texture* texture, sf::Uint32 item) {
+        return (static_cast<sf::Uint64>(layer) << 48) | (static_cast<sf::Uint64>(textureId(texture)) << 32) | item;
+    }
+
+    // Small ids in first-seen order; a frame only binds a handful of textures.
+    sf::Uint32 textureId(const sf::Texture* texture) {
+        if (!textures.empty() && textures.back() == texture)
+            return static_cast<sf::Uint32>(textures.size() - 1);
+        for (size_t i = 0; i < textures.size(); ++i)
+            if (textures[i] == texture)
+                return static_cast<sf::Uint32>(i);
+        textures.push_back(texture);
+        return static_cast<sf::Uint32>(textures.size() - 1);
+    }
+
+    // Stable LSD radix sort, a byte at a time, over the layer and texture bits.
+    // A byte every key shares is skipped, so a layer on a single texture costs
+    // only the counting pass.
+    void sort() {
+        if (keys.empty())
+            return;
+        scratch.resize(keys.size());
+        for (int shift = 32; shift < 56; shift += 8) {
+            size_t offsets[256] = {};
+            for (sf::Uint64 k : keys)
+                ++offsets[(k >> shift) & 0xFF];
+            if (offsets[(keys[0] >> shift) & 0xFF] == keys.size())
+                continue;
+            size_t total = 0;
+            for (size_t& offset : offsets) {
+                const size_t count = offset;
+                offset = total;
+                total += count;
+            }
+            for (sf::Uint64 k : keys)
+                scratch[offsets[(k >> shift) & 0xFF]++] = k;
+            keys.swap(scratch);
+        }
+    }
+
+    SpriteBatch& batch;
+    std::vector<sf::Uint64> keys, scratch;
+    std::vector<SpriteInstance> sprites;
+    std::vector<Geometry> arrays;
+    std::vector<const sf::Texture*> textures;
+};
+
+// --- Retained HUD ---
+// Lays the HUD's texts and bars out as vertices once and keeps drawing those
+// until something on it changes. Each character size with a page of its own is
+// one draw from the font's glyphs, and all bars are one more, untextured and
+// under the text. Text smaller than a page is scaled down from the next larger one.
+//
+// Numbers live in counters: fixed runs of quads whose digits are rewritten in
+// place from glyph metrics taken once per page, so a changing value costs no
+// string, no glyph lookup and no layout.
+class HudLayer {
+public:
+    explicit HudLayer(const sf::Font& font) : font(font), barVertices(sf::Triangles) {}
+
+    // Rasterizes every printable ASCII glyph at this size now, so nothing is
+    // rendered by FreeType mid-game.
+    void addPage(unsigned characterSize) {
+        Page page;
+        page.characterSize = characterSize;
+        for (sf::Uint32 c = ' '; c <= '~'; ++c) {
+            font.getGlyph(c, characterSize, false);
+            font.getGlyph(c, characterSize, true);
+        }
+        const char counterCharacters[COUNTER_GLYPHS + 1] = "0123456789:-";
+        for (int i = 0; i < COUNTER_GLYPHS; ++i)
+            page.counterGlyphs[i] = font.getGlyph(counterCharacters[i], characterSize, false);
+        pages.push_back(page);
+        std::sort(pages.begin(), pages.end(), [](const Page& a, const Page& b) { return a.characterSize < b.characterSize; });
+    }
+
+    // Drops everything, counters and bars included, before laying the HUD out again.
+    void clear() {
+        for (auto& page : pages)
+            page.vertices.clear();
+        counters.clear();
+        barVertices.clear();
+        bars.clear();
+    }
+
+    // Bars are drawn in the order added. Returns a handle for setBar.
+    int addBar(const sf::RectangleShape& rect) {
+        bars.push_back(barVertices.getVertexCount());
+        barVertices.resize(barVertices.getVertexCount() + VERTICES_PER_QUAD);
+        setBar(static_cast<int>(bars.size()) - 1, rect);
+        return static_cast<int>(bars.size()) - 1;
+    }
+
+    void setBar(int bar, const sf::RectangleShape& rect) {
+        if (bar < 0)
+            return;
+        const sf::Vector2f size = rect.getSize();
+        quad(&barVertices[bars[bar]], rect.getTransform(), sf::FloatRect(0.f, 0.f, size.x, size.y), sf::FloatRect(), rect.getFillColor());
+    }
+
+    // Same layout as sf::Text for the regular and bold styles. Returns where
+    // the text ends, for a counter that follows it.
+    sf::Vector2f add(const sf::Text& text) {
+        Page& page = pageFor(text.getCharacterSize());
+        const sf::Transform transform = transformFor(text, text.getPosition());
+        const unsigned size = page.characterSize;
+        const bool bold = (text.getStyle() & sf::Text::Bold) != 0;
+        const sf::String& string = text.getString();
+        float x = 0.f, y = static_cast<float>(size);
+        sf::Uint32 previous = 0;
+        for (size_t i = 0; i < string.getSize(); ++i) {
+            const sf::Uint32 c = string[i];
+            if (c == '\r')
+                continue;
+            x += font.getKerning(previous, c, size, bold);
+            previous = c;
+            if (c == '\n') {
+                x = 0.f;
+                y += font.getLineSpacing(size);
+                continue;
+            }
+            const sf::Glyph& glyph = font.getGlyph(c, size, bold);
+            if (c != ' ' && c != '\t')
+                glyphQuad(page, transform, glyph, x, y, text.getFillColor());
+            x += glyph.advance;
+        }
+        return transform.transformPoint(x, y - size);
+    }
+
+    // Reserves room for up to `capacity` characters drawn in the size and color
+    // of `style`, starting at `position`. Returns a handle for setNumber/setClock.
+    int addCounter(const sf::Text& style, sf::Vector2f position, int capacity) {
+        Page& page = pageFor(style.getCharacterSize());
+        Counter counter;
+        counter.page = static_cast<int>(&page - &pages[0]);
+        counter.first = page.vertices.getVertexCount();
+        counter.capacity = std::min<int>(capacity, MAX_COUNTER_LENGTH);
+        counter.transform = transformFor(style, position);
+        counter.color = style.getFillColor();
+        page.vertices.resize(counter.first + counter.capacity * VERTICES_PER_QUAD);
+        counters.push_back(counter);
+        return static_cast<int>(counters.size()) - 1;
+    }
+
+    // A value wider than the counter shows as all nines.
+    void setNumber(int counter, int value, int minDigits = 1) {
+        if (counter < 0)
+            return;
+        const int width = std::max(1, counters[counter].capacity - (value < 0 ? 1 : 0));
+        char digits[MAX_COUNTER_LENGTH];
+        int count = 0;
+        unsigned magnitude = value < 0 ? 0u - static_cast<unsigned>(value) : static_cast<unsigned>(value);
+        do {
+            digits[count++] = static_cast<char>('0' + magnitude % 10);
+            magnitude /= 10;
+        } while ((magnitude || count < minDigits) && count < width);
+        if (magnitude)
+            std::fill(digits, digits + count, '9');
+        if (value < 0 && count < MAX_COUNTER_LENGTH)
+            digits[count++] = '-';
+        std::reverse(digits, digits + count);
+        write(counter, digits, count);
+    }
+
+    // Minutes and seconds as MM:SS.
+    void setClock(int counter, int seconds) {
+        char clock[MAX_COUNTER_LENGTH];
+        int count = 0;
+        int minutes = std::min(seconds / 60, 999);
+        if (minutes >= 100)
+            clock[count++] = static_cast<char>('0' + minutes / 100);
+        clock[count++] = static_cast<char>('0' + minutes / 10 % 10);
+        clock[count++] = static_cast<char>('0' + minutes % 10);
+        clock[count++] = ':';
+        clock[count++] = static_cast<char>('0' + seconds % 60 / 10);
+        clock[count++] = static_cast<char>('0' + seconds % 10);
+        write(counter, clock, count);
+    }
+
+    // Bars first: the queue keeps a layer's textures in the order they are first submitted
+    void submit(RenderQueue& queue) const {
+        queue.submit(RenderQueue::HUD, barVertices, nullptr);
+        for (const auto& page : pages)
+            queue.submit(RenderQueue::HUD, page.vertices, &font.getTexture(page.characterSize));
+    }
+
+private:
+    enum { COUNTER_GLYPHS = 12, MAX_COUNTER_LENGTH = 12, VERTICES_PER_QUAD = 6 };
+
+    struct Page {
+        unsigned characterSize = 0;
+        sf::VertexArray vertices = sf::VertexArray(sf::Triangles);
+        sf::Glyph counterGlyphs[COUNTER_GLYPHS] = {};
+    };
+
+    struct Counter {
+        int page;
+        size_t first;
+        int capacity;
+        sf::Transform transform;
+        sf::Color color;
+    };
+
+    Page& pageFor(unsigned characterSize) {
+        for (auto& page : pages)
+            if (page.characterSize >= characterSize)
+                return page;
+        return pages.back();
+    }
+
+    // The text's own transform at `position`, scaled from its page to its size.
+    sf::Transform transformFor(const sf::Text& text, sf::Vector2f position) {
+        sf::Transform transform;
+        transform.translate(position);
+        transform.rotate(text.getRotation());
+        transform.scale(text.getScale().x, text.getScale().y);
+        transform.translate(-text.getOrigin());
+        const float scale = static_cast<float>(text.getCharacterSize()) / pageFor(text.getCharacterSize()).characterSize;
+        transform.scale(scale, scale);
+        return transform;
+    }
+
+    // Unused slots collapse to zero-area quads.
+    void write(int counter, const char* characters, int count) {
+        if (counter < 0)
+            return;
+        const Counter& c = counters[counter];
+        Page& page = pages[c.page];
+        sf::Vertex* vertices = &page.vertices[c.first];
+        float x = 0.f;
+        for (int i = 0; i < c.capacity; ++i, vertices += VERTICES_PER_QUAD) {
+            if (i >= count) {
+                for (int v = 0; v < VERTICES_PER_QUAD; ++v)
+                    vertices[v] = sf::Vertex();
+                continue;
+            }
+            const char ch = characters[i];
+            const sf::Glyph& glyph = page.counterGlyphs[ch == ':' ? 10 : ch == '-' ? 11 : ch - '0'];
+            glyphQuad(vertices, c.transform, glyph, x, static_cast<float>(page.characterSize), c.color);
+            x += glyph.advance;
+        }
+    }
+
+    void glyphQuad(Page& page, const sf::Transform& transform, const sf::Glyph& glyph, float x, float y, sf::Color color) {
+        const size_t first = page.vertices.getVertexCount();
+        page.vertices.resize(first + VERTICES_PER_QUAD);
+        glyphQuad(&page.vertices[first], transform, glyph, x, y, color);
+    }
+
+    static void glyphQuad(sf::Vertex* out, const sf::Transform& transform, const sf::Glyph& glyph, float x, float y, sf::Color color) {
+        const float padding = 1.f;
+        const sf::FloatRect& b = glyph.bounds;
+        const sf::IntRect& t = glyph.textureRect;
+        quad(out, transform,
+            sf::FloatRect(x + b.left - padding, y + b.top - padding, b.width + 2 * padding, b.height + 2 * padding),
+            sf::FloatRect(t.left - padding, t.top - padding, t.width + 2 * padding, t.height + 2 * padding),
+            color);
+    }
+
+    static void quad(sf::Vertex* out, const sf::Transform& transform, const sf::FloatRect& area, const sf::FloatRect& uv, sf::Color color) {
+        const sf::Vector2f corners[4] = {
+            transform.transformPoint(area.left, area.top), transform.transformPoint(area.left + area.width, area.top),
+            transform.transformPoint(area.left + area.width, area.top + area.height), transform.transformPoint(area.left, area.top + area.height) };
+        const sf::Vector2f coords[4] = {
+            { uv.left, uv.top }, { uv.left + uv.width, uv.top }, { uv.left + uv.width, uv.top + uv.height }, { uv.left, uv.top + uv.height } };
+        static const int TRIANGLES[VERTICES_PER_QUAD] = { 0, 1, 2, 0, 2, 3 };
+        for (int i = 0; i < VERTICES_PER_QUAD; ++i)
+            out[i] = sf::Vertex(corners[TRIANGLES[i]], color, coords[TRIANGLES[i]]);
+    }
+
+    const sf::Font& font;
+    std::vector<Page> pages;
+    std::vector<Counter> counters;
+    sf::VertexArray barVertices; // untextured
+    std::vector<size_t> bars; // first vertex of each bar in barVertices
+};
+
+// --- Gameplay Events ---
+// What collision handling reports instead of playing sounds, shaking the camera
+// and spawning explosions itself.
+struct GameEvent {
+    enum Type : sf::Uint8 { HIT, KILL, PLAYER_DAMAGED, POWERUP_COLLECTED };
+    enum Source : sf::Uint8 { NONE, ENEMY_ESCAPED, BOSS_BULLET };
+    Type type;
+    Source source;
+    sf::Int16 amount;   // damage, score or health gained
+    float x, y;         // where it happened
+};
+
+// Fixed-size FIFO. Items stay in place until clear(), so several consumers can
+// read the same batch in turn.
+template <typename T, size_t Capacity>
+class RingBuffer {
+public:
+    static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+    bool empty() const { return head == tail; }
+    bool full() const { return tail - head == Capacity; }
+    size_t size() const { return tail - head; }
+
+    bool push(const T& item) {
+        if (full())
+            return false;
+        items[tail++ & (Capacity - 1)] = item;
+        return true;
+    }
+
+    const T& operator[](size_t i) const { return items[(head + i) & (Capacity - 1)]; }
+    void clear() { head = tail; }
+
+private:
+    T items[Capacity];
+    size_t head = 0, tail = 0;
+};
+
+// --- Job System ---
+// Small work-stealing scheduler for data-parallel loops over entity ranges.
+// Each thread (the workers plus the one calling parallelFor) owns a deque of
+// range jobs. A thread splits its job in halves, keeps the newest half from the
+// back of its own deque and idle threads steal the oldest, biggest halves from
+// the front. Only one thread may call parallelFor at a time, and not from inside a job.
+class JobSystem {
+public:
+    typedef std::function<void(size_t, size_t)> RangeFunction;
+
+    explicit JobSystem(unsigned workerCount = std::max(1u, std::thread::hardware_concurrency()) - 1)
+        : queueCount(workerCount + 1), queues(new WorkQueue[workerCount + 1]), activeBatches(0), stopping(false)
+    {
+        for (unsigned i = 0; i < workerCount; ++i)
+            workers.emplace_back(&JobSystem::workerLoop, this, i + 1);
+    }
+
+    ~JobSystem() {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto& worker : workers)
+            worker.join();
+    }
+
+    size_t threadCount() const { return queueCount; }
+    // The queue the calling thread serves: workers have 1 .. threadCount() - 1
+    // and the thread calling parallelFor has 0, so jobs can index per-thread
+    // scratch space.
+    static size_t currentSlot() { return threadSlot; }
+
+    // Calls fn on disjoint sub-ranges of [begin, end), none longer than grain,
+    // and returns once all of them are done. The calling thread helps out.
+    void parallelFor(size_t begin, size_t end, size_t grain, const RangeFunction& fn) {
+        if (begin >= end)
+            return;
+        if (end - begin <= grain || workers.empty()) {
+            fn(begin, end);
+            return;
+        }
+        Batch batch;
+        batch.fn = &fn;
+        batch.grain = std::max<size_t>(1, grain);
+        batch.remaining = end - begin;
+        push(0, Job{ &batch, begin, end });
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            activeBatches++;
+        }
+        wake.notify_all();
+        while (batch.remaining.load(std::memory_order_acquire) != 0) {
+            Job job;
+            if (pop(0, job) || steal(0, job))
+                execute(0, job);
+            else
+                std::this_thread::yield();
+        }
+        activeBatches--;
+    }
+
+private:
+    struct Batch {
+        const RangeFunction* fn;
+        size_t grain;
+        std::atomic<size_t> remaining; // items not processed yet
+    };
+    struct Job {
+        Batch* batch;
+        size_t begin, end;
+    };
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<Job> jobs;
+    };
+
+    static constexpr int IDLE_SPINS = 2000; // yields before an idle worker goes to sleep
+    static thread_local size_t threadSlot;
+
+    size_t queueCount;
+    std::unique_ptr<WorkQueue[]> queues;
+    std::vector<std::thread> workers;
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    std::atomic<int> activeBatches;
+    bool stopping;
+
+    void push(size_t slot, const Job& job) {
+        std::lock_guard<std::mutex> lock(queues[slot].mutex);
+        queues[slot].jobs.push_back(job);
+    }
+
+    bool pop(size_t slot, Job& job) {
+        std::lock_guard<std::mutex> lock(queues[slot].mutex);
+        if (queues[slot].jobs.empty())
+            return false;
+        job = queues[slot].jobs.back();
+        queues[slot].jobs.pop_back();
+        return true;
+    }
+
+    bool steal(size_t slot, Job& job) {
+        for (size_t i = 1; i < queueCount; ++i) {
+            WorkQueue& victim = queues[(slot + i) % queueCount];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.jobs.empty()) {
+                job = victim.jobs.front();
+                victim.jobs.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Splits off the upper half until the job is small enough, then runs it.
+    void execute(size_t slot, Job job) {
+        while (job.end - job.begin > job.batch->grain) {
+            size_t mid = job.begin + (job.end - job.begin) / 2;
+            push(slot, Job{ job.batch, mid, job.end });
+            job.end = mid;
+        }
+        (*job.batch->fn)(job.begin, job.end);
+        job.batch->remaining.fetch_sub(job.end - job.begin, std::memory_order_acq_rel);
+    }
+
+    void workerLoop(size_t slot) {
+        threadSlot = slot;
+        int idleSpins = 0;
+        while (true) {
+            Job job;
+            if (pop(slot, job) || steal(slot, job)) {
+                execute(slot, job);
+                idleSpins = 0;
+                continue;
+            }
+            if (++idleSpins < IDLE_SPINS) {
+                std::this_thread::yield();
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            wake.wait(lock, [this] { return stopping || activeBatches.load() > 0; });
+            if (stopping)
+                return;
+            idleSpins = 0;
+        }
+    }
+};
+thread_local size_t JobSystem::threadSlot = 0;
+
+// --- Collision Broadphase ---
+// Uniform grid over the playfield, rebuilt from scratch every tick. Each item is
+// binned into every cell its bounds touch; items outside the playfield go to the
+// nearest edge cells, which queries clamp to as well, so nothing is ever missed.
+// Cells are packed into one array by a counting sort, which keeps every cell's
+// items in ascending index order, with their boxes alongside in columns.
+class UniformGrid {
+public:
+    void build(const std::vector<Aabb>& bounds) {
+        cellStart.assign(COLUMNS * ROWS + 1, 0);
+        for (const Aabb& b : bounds)
+            forEachCell(b, [this](int c) { cellStart[c + 1]++; });
+        for (int c = 0; c < COLUMNS * ROWS; ++c)
+            cellStart[c + 1] += cellStart[c];
+        items.resize(cellStart.back());
+        boxes.resize(cellStart.back());
+        fill.assign(cellStart.begin(), cellStart.end() - 1);
+        for (size_t i = 0; i < bounds.size(); ++i) {
+            forEachCell(bounds[i], [this, &bounds, i](int c) {
+                boxes.set(fill[c], bounds[i]);
+                items[fill[c]++] = static_cast<int>(i);
+            });
+        }
+    }
+
+    // Calls visit(index) for every item overlapping 'area', tested a block of a
+    // cell at a time. An item spanning several cells is visited once per cell.
+    template <typename F>
+    void query(const Aabb& area, F visit) const {
+        forEachCell(area, [this, &area, &visit](int c) {
+            const size_t end = cellStart[c + 1];
+            for (size_t first = cellStart[c]; first < end; first += AabbColumns::BLOCK) {
+                const sf::Uint32 hits = OverlapKernel::overlap(area, boxes, first) & OverlapKernel::firstBits(end - first);
+                OverlapKernel::forEachBit(hits, [this, first, &visit](size_t k) { visit(items[first + k]); });
+            }
+        });
+    }
+
+private:
+    static constexpr int COLUMNS = (GameConfig::WINDOW_WIDTH + GameConfig::COLLISION_CELL_SIZE - 1) / GameConfig::COLLISION_CELL_SIZE;
+    static constexpr int ROWS = (GameConfig::WINDOW_HEIGHT + GameConfig::COLLISION_CELL_SIZE - 1) / GameConfig::COLLISION_CELL_SIZE;
+    std::vector<int> cellStart; // items of cell c are items[cellStart[c] .. cellStart[c + 1])
+    std::vector<int> items;
+    AabbColumns boxes; // boxes[k] is the bounds of items[k]
+    std::vector<int> fill;
+
+    static int cellOf(float v, int count) {
+        int c = static_cast<int>(std::floor(v / GameConfig::COLLISION_CELL_SIZE));
+        return std::max(0, std::min(c, count - 1));
+    }
+    template <typename F>
+    static void forEachCell(const Aabb& b, F f) {
+        const int x0 = cellOf(b.left, COLUMNS), x1 = cellOf(b.right, COLUMNS);
+        const int y0 = cellOf(b.top, ROWS), y1 = cellOf(b.bottom, ROWS);
+        for (int y = y0; y <= y1; ++y)
+            for (int x = x0; x <= x1; ++x)
+                f(y * COLUMNS + x);
+    }
+};
+
+// Follows items from one tick to the next by their owner. Survivors keep their
+// relative order in 'owners' and newcomers are appended, so a single pass over
+// both lists finds where everyone went.
+class OwnerTracker {
+public:
+    std::vector<int> newIndex; // this tick's index of each previous owner, or -1
+
+    // Returns how many owners at the end of the list are new
+    template <typename Owner>
+    size_t update(const std::vector<Owner*>& owners) {
+        newIndex.assign(previousOwners.size(), -1);
+        size_t arrivals = 0;
+        for (size_t i = 0, k = 0; i < owners.size(); ++i) {
+            size_t found = k;
+            while (found < previousOwners.size() && previousOwners[found] != owners[i])
+                ++found;
+            if (found == previousOwners.size()) {
+                arrivals = owners.size() - i;
+                break;
+            }
+            newIndex[found] = static_cast<int>(i);
+            k = found + 1;
+        }
+        previousOwners.assign(owners.begin(), owners.end());
+        return arrivals;
+    }
+
+private:
+    std::vector<const void*> previousOwners;
+};
+
+// Sort-and-sweep along x: items are kept sorted by their left edge, so a query
+// only scans the run of items whose x-spans can reach the area, a block at a time.
+// Enemies and bullets move almost only vertically, so last tick's order is still
+// nearly right: it is carried over by owner and repaired with an insertion sort.
+class SortAndSweep {
+public:
+    template <typename Owner>
+    void build(const std::vector<Aabb>& bounds, const std::vector<Owner*>& owners) {
+        const size_t arrivals = tracker.update(owners);
+        size_t kept = 0;
+        for (int old : order)
+            if (tracker.newIndex[old] >= 0)
+                order[kept++] = tracker.newIndex[old];
+        order.resize(kept);
+        for (size_t i = owners.size() - arrivals; i < owners.size(); ++i)
+            order.push_back(static_cast<int>(i));
+        auto byLeft = [&bounds](int a, int b) { return bounds[a].left < bounds[b].left; };
+        if (arrivals * 8 > order.size()) {
+            std::sort(order.begin(), order.end(), byLeft);
+        }
+        else {
+            for (size_t i = 1; i < order.size(); ++i) {
+                const int item = order[i];
+                size_t j = i;
+                for (; j > 0 && byLeft(item, order[j - 1]); --j)
+                    order[j] = order[j - 1];
+                order[j] = item;
+            }
+        }
+
+        boxes.resize(order.size());
+        maxWidth = 0.f;
+        for (size_t k = 0; k < order.size(); ++k) {
+            boxes.set(k, bounds[order[k]]);
+            maxWidth = std::max(maxWidth, bounds[order[k]].width());
+        }
+    }
+
+    // Calls visit(index) once for every item overlapping 'area', in no particular order
+    template <typename F>
+    void query(const Aabb& area, F visit) const {
+        const auto lefts = boxes.left.begin(), end = lefts + boxes.count;
+        // Left edges more than the widest item before the area cannot reach it;
+        // the extra pixel keeps rounding from cutting off a touching one.
+        const size_t from = std::upper_bound(lefts, end, area.left - maxWidth - 1.f) - lefts;
+        const size_t to = std::lower_bound(lefts + from, end, area.right) - lefts;
+        for (size_t first = from; first < to; first += AabbColumns::BLOCK) {
+            const sf::Uint32 hits = OverlapKernel::overlap(area, boxes, first) & OverlapKernel::firstBits(to - first);
+            OverlapKernel::forEachBit(hits, [this, first, &visit](size_t k) { visit(order[first + k]); });
+        }
+    }
+
+private:
+    std::vector<int> order; // item indices by left edge
+    AabbColumns boxes; // boxes[k] is the bounds of item order[k]
+    float maxWidth = 0.f;
+    OwnerTracker tracker;
+};
+
+// Loose quadtree for items that crowd into small areas. A node's loose bounds
+// are its square grown by half its size on every side, and each item lives in
+// exactly one node: the deepest whose loose bounds hold its box (the root takes
+// anything). Nodes split once they hold more than QUADTREE_NODE_CAPACITY items
+// and merge back once their subtree thins out to half that, so the tree is only
+// deep where items cluster. Items are carried over by owner, and one whose box
+// still fits its node's loose bounds is not moved at all.
+class LooseQuadtree {
+public:
+    template <typename Owner>
+    void build(const std::vector<Aabb>& bounds, const std::vector<Owner*>& owners) {
+        // The root spans the playfield and as much again around it, where
+        // enemies and bullets enter and leave
+        if (nodes.empty())
+            nodes.push_back(makeNode(-1, 0, GameConfig::WINDOW_WIDTH / 2.f, GameConfig::WINDOW_HEIGHT / 2.f,
+                std::max(GameConfig::WINDOW_WIDTH, GameConfig::WINDOW_HEIGHT) * 1.5f));
+        const size_t arrivals = tracker.update(owners);
+        nextHandles.resize(owners.size());
+        for (size_t old = 0; old < handles.size(); ++old) {
+            const int h = handles[old], now = tracker.newIndex[old];
+            if (now < 0) {
+                remove(h);
+                freeItems.push_back(h);
+                continue;
+            }
+            nextHandles[now] = h;
+            Item& item = items[h];
+            item.index = now;
+            item.box = bounds[now];
+            if (item.node == 0 || contains(nodes[item.node].loose, item.box)) {
+                nodes[item.node].boxes.set(item.slot, item.box);
+            }
+            else {
+                remove(h);
+                insert(h);
+            }
+        }
+        for (size_t i = owners.size() - arrivals; i < owners.size(); ++i) {
+            int h;
+            if (freeItems.empty()) {
+                h = static_cast<int>(items.size());
+                items.emplace_back();
+            }
+            else {
+                h = freeItems.back();
+                freeItems.pop_back();
+            }
+            items[h].index = static_cast<int>(i);
+            items[h].box = bounds[i];
+            insert(h);
+            nextHandles[i] = h;
+        }
+        handles.swap(nextHandles);
+    }
+
+    // Calls visit(index) once for every item overlapping 'area', in no particular order
+    template <typename F>
+    void query(const Aabb& area, F visit) const {
+        if (nodes.empty())
+            return;
+        int stack[3 * GameConfig::QUADTREE_MAX_DEPTH + 1];
+        int top = 0;
+        stack[top++] = 0;
+        while (top > 0) {
+            const Node& node = nodes[stack[--top]];
+            for (size_t first = 0; first < node.boxes.count; first += AabbColumns::BLOCK) {
+                const sf::Uint32 hits = OverlapKernel::overlap(area, node.boxes, first) & OverlapKernel::firstBits(node.boxes.count - first);
+                OverlapKernel::forEachBit(hits, [this, &node, first, &visit](size_t k) { visit(items[node.items[first + k]].index); });
+            }
+            if (node.children >= 0)
+                for (int c = node.children; c < node.children + 4; ++c)
+                    if (nodes[c].loose.intersects(area))
+                        stack[top++] = c;
+        }
+    }
+
+private:
+    struct Node {
+        Aabb loose;
+        float centerX, centerY, half; // the node's square
+        int parent, depth;
+        int children; // first of four consecutive nodes, or -1 for a leaf
+        int total; // items in the subtree
+        std::vector<int> items;
+        AabbColumns boxes; // boxes[k] is the box of items[k]
+    };
+    struct Item {
+        Aabb box;
+        int node, slot; // where it is stored: nodes[node].items[slot]
+        int index; // this tick's index in 'bounds'
+    };
+    std::vector<Node> nodes; // nodes[0] is the root
+    std::vector<int> freeQuads; // first of four unused consecutive nodes
+    std::vector<Item> items; // by handle
+    std::vector<int> freeItems;
+    std::vector<int> handles, nextHandles; // handle of each index
+    OwnerTracker tracker;
+
+    static Node makeNode(int parent, int depth, float centerX, float centerY, float half) {
+        Node node;
+        node.loose.left = centerX - 2.f * half;
+        node.loose.top = centerY - 2.f * half;
+        node.loose.right = centerX + 2.f * half;
+        node.loose.bottom = centerY + 2.f * half;
+        node.centerX = centerX;
+        node.centerY = centerY;
+        node.half = half;
+        node.parent = parent;
+        node.depth = depth;
+        node.children = -1;
+        node.total = 0;
+        node.boxes.resize(0);
+        return node;
+    }
+    static bool contains(const Aabb& outer, const Aabb& b) {
+        return b.left >= outer.left && b.right <= outer.right && b.top >= outer.top && b.bottom <= outer.bottom;
+    }
+    // The child of a split node whose square holds the box's center
+    int childFor(int n, const Aabb& b) const {
+        const Node& node = nodes[n];
+        return node.children + ((b.left + b.right) * 0.5f >= node.centerX) + 2 * ((b.top + b.bottom) * 0.5f >= node.centerY);
+    }
+
+    void store(int h, int n) {
+        items[h].node = n;
+        items[h].slot = static_cast<int>(nodes[n].items.size());
+        nodes[n].items.push_back(h);
+        nodes[n].boxes.push(items[h].box);
+    }
+    void insert(int h) {
+        const Aabb& box = items[h].box;
+        int n = 0;
+        for (;;) {
+            nodes[n].total++;
+            if (nodes[n].children < 0)
+                break;
+            const int c = childFor(n, box);
+            if (!contains(nodes[c].loose, box))
+                break;
+            n = c;
+        }
+        store(h, n);
+        if (nodes[n].children < 0)
+            splitIfFull(n);
+    }
+    void remove(int h) {
+        const int n = items[h].node, slot = items[h].slot;
+        std::vector<int>& list = nodes[n].items;
+        const int last = list.back();
+        list[slot] = last;
+        items[last].slot = slot;
+        list.pop_back();
+        nodes[n].boxes.set(slot, items[last].box);
+        nodes[n].boxes.pop();
+        int merge = -1;
+        for (int up = n; up >= 0; up = nodes[up].parent) {
+            nodes[up].total--;
+            if (nodes[up].children >= 0 && nodes[up].total <= GameConfig::QUADTREE_NODE_CAPACITY / 2)
+                merge = up;
+        }
+        if (merge >= 0)
+            collapse(merge, merge);
+    }
+
+    void splitIfFull(int n) {
+        if (static_cast<int>(nodes[n].items.size()) <= GameConfig::QUADTREE_NODE_CAPACITY || nodes[n].depth >= GameConfig::QUADTREE_MAX_DEPTH)
+            return;
+        int first;
+        if (freeQuads.empty()) {
+            first = static_cast<int>(nodes.size());
+            nodes.resize(nodes.size() + 4);
+        }
+        else {
+            first = freeQuads.back();
+            freeQuads.pop_back();
+        }
+        const float half = nodes[n].half * 0.5f;
+        for (int k = 0; k < 4; ++k) {
+            const float x = nodes[n].centerX + (k & 1 ? half : -half);
+            const float y = nodes[n].centerY + (k & 2 ? half : -half);
+            nodes[first + k] = makeNode(n, nodes[n].depth + 1, x, y, half);
+        }
+        nodes[n].children = first;
+        std::vector<int> moving;
+        moving.swap(nodes[n].items);
+        nodes[n].boxes.resize(0);
+        for (int h : moving) {
+            const int c = childFor(n, items[h].box);
+            if (contains(nodes[c].loose, items[h].box)) {
+                nodes[c].total++;
+                store(h, c);
+            }
+            else {
+                store(h, n);
+            }
+        }
+        for (int c = first; c < first + 4; ++c)
+            splitIfFull(c);
+    }
+    // Moves every item below 'from' into node 'into' and frees the children
+    void collapse(int from, int into) {
+        const int first = nodes[from].children;
+        if (first < 0)
+            return;
+        for (int c = first; c < first + 4; ++c) {
+            collapse(c, into);
+            for (int h : nodes[c].items)
+                store(h, into);
+            nodes[c].items.clear();
+            nodes[c].boxes.resize(0);
+        }
+        nodes[from].children = -1;
+        freeQuads.push_back(first);
+    }
+};
+
+// Which kinds of collider can touch: bit b of MATRIX[a] is set when layers a and
+// b interact. The matrix is symmetric, so each pair is tested from one side only,
+// whichever has fewer colliders querying the other.
+struct CollisionLayers {
+    enum Layer { PLAYER_SHOT, ENEMY_SHOT, ENEMY, BOSS, PLAYER, POWER_UP, COUNT };
+    static const sf::Uint32 MATRIX[COUNT];
+    static sf::Uint32 bit(int layer) { return 1u << layer; }
+};
+const sf::Uint32 CollisionLayers::MATRIX[CollisionLayers::COUNT] = {
+    1u << ENEMY | 1u << BOSS | 1u << POWER_UP, // PLAYER_SHOT
+    1u << PLAYER,                              // ENEMY_SHOT
+    1u << PLAYER_SHOT,                         // ENEMY
+    1u << PLAYER_SHOT,                         // BOSS
+    1u << ENEMY_SHOT,                          // PLAYER
+    1u << PLAYER_SHOT,                         // POWER_UP
+};
+
+// Colliders binned by layer, each layer in the structure that suits it: a plain
+// list for a handful of items, a grid, sort-and-sweep or a quadtree for crowds. A query names
+// the layers it wants with a mask, so every other layer is skipped whole before a
+// single box is compared. Layers not built since clear() are empty.
+class LayeredBroadphase {
+public:
+    void clear() {
+        std::fill(kinds, kinds + CollisionLayers::COUNT, EMPTY);
+    }
+    void buildList(int layer, const Aabb* bounds, size_t count) {
+        kinds[layer] = LIST;
+        boxes[layer].assign(bounds, bounds + count);
+        lists[layer].resize(count);
+        for (size_t i = 0; i < count; ++i)
+            lists[layer].set(i, bounds[i]);
+    }
+    void buildGrid(int layer, const std::vector<Aabb>& bounds) {
+        kinds[layer] = GRID;
+        boxes[layer] = bounds;
+        grids[layer].build(bounds);
+    }
+    template <typename Owner>
+    void buildSweep(int layer, const std::vector<Aabb>& bounds, const std::vector<Owner*>& owners) {
+        kinds[layer] = SORT_AND_SWEEP;
+        boxes[layer] = bounds;
+        sweeps[layer].build(bounds, owners);
+    }
+    template <typename Owner>
+    void buildTree(int layer, const std::vector<Aabb>& bounds, const std::vector<Owner*>& owners) {
+        kinds[layer] = QUADTREE;
+        boxes[layer] = bounds;
+        trees[layer].build(bounds, owners);
+    }
+
+    const Aabb& bounds(int layer, int index) const {
+        return boxes[layer][index];
+    }
+
+    // Calls visit(layer, index) for every item overlapping 'area' on the layers
+    // in 'mask'. Grid items may be visited once per cell they share with the area.
+    template <typename F>
+    void query(const Aabb& area, sf::Uint32 mask, F visit) const {
+        OverlapKernel::forEachBit(mask, [this, &area, &visit](size_t bit) {
+            const int layer = static_cast<int>(bit);
+            auto item = [layer, &visit](int index) { visit(layer, index); };
+            switch (kinds[layer]) {
+            case LIST: {
+                const AabbColumns& boxes = lists[layer];
+                for (size_t first = 0; first < boxes.count; first += AabbColumns::BLOCK) {
+                    const sf::Uint32 hits = OverlapKernel::overlap(area, boxes, first) & OverlapKernel::firstBits(boxes.count - first);
+                    OverlapKernel::forEachBit(hits, [first, &item](size_t k) { item(static_cast<int>(first + k)); });
+                }
+                break;
+            }
+            case GRID:
+                grids[layer].query(area, item);
+                break;
+            case SORT_AND_SWEEP:
+                sweeps[layer].query(area, item);
+                break;
+            case QUADTREE:
+                trees[layer].query(area, item);
+                break;
+            case EMPTY:
+                break;
+            }
+        });
+    }
+
+private:
+    enum Kind { EMPTY, LIST, GRID, SORT_AND_SWEEP, QUADTREE };
+    Kind kinds[CollisionLayers::COUNT] = {};
+    std::vector<Aabb> boxes[CollisionLayers::COUNT]; // by index, as built
+    AabbColumns lists[CollisionLayers::COUNT];
+    UniformGrid grids[CollisionLayers::COUNT];
+    SortAndSweep sweeps[CollisionLayers::COUNT];
+    LooseQuadtree trees[CollisionLayers::COUNT];
+};
+
+// --- Spatial Queries ---
+// Nearest, ray and circle queries over a LayeredBroadphase, for gameplay that has
+// to find things rather than collide with them (homing shots, lasers, smart
+// bombs). Every query is also offered in batches, which run on the job system.
+// Distances are to the nearest point of a box, and ties go to the lower layer
+// and index, so results never depend on how a layer is binned.
+struct SpatialHit {
+    int layer, index; // -1 when nothing was found
+    float distance;
+};
+struct Ray {
+    sf::Vector2f origin, direction; // direction of unit length
+    float length;
+};
+struct Circle {
+    sf::Vector2f center;
+    float radius;
+};
+
+class SpatialQueries {
+public:
+    // Working space for nearest(), reused from one query to the next
+    struct Scratch {
+        std::vector<SpatialHit> found;
+        float radius = SEARCH_START;
+    };
+
+    SpatialQueries(const LayeredBroadphase& broadphase, JobSystem& jobs)
+        : broadphase(broadphase), jobs(jobs), scratch(jobs.threadCount()) {}
+
+    // The k items nearest to 'point', nearest first, in out[0 .. k). Slots past
+    // the last item found get layer -1. The search square starts at 'radius' and
+    // doubles until it holds k items, then gives up on distance altogether; the
+    // radius it ended at is left in 'radius'. Any start gives the same answer,
+    // but one close to the final radius saves broadphase queries.
+    void nearest(sf::Vector2f point, int k, sf::Uint32 mask, SpatialHit* out, Scratch& scratch) const {
+        std::vector<SpatialHit>& found = scratch.found;
+        float& radius = scratch.radius;
+        for (;; radius *= 2.f) {
+            const bool everywhere = radius > SEARCH_LIMIT;
+            const Aabb area = everywhere ? EVERYWHERE : square(point, radius);
+            found.clear();
+            broadphase.query(area, mask, [&](int layer, int index) {
+                const float d = distance(point, broadphase.bounds(layer, index));
+                if (everywhere || d < radius)
+                    found.push_back(SpatialHit{ layer, index, d });
+            });
+            std::sort(found.begin(), found.end(), closer);
+            found.erase(std::unique(found.begin(), found.end(), same), found.end()); // grid cells repeat items
+            if (static_cast<int>(found.size()) >= k || everywhere)
+                break;
+        }
+        for (int j = 0; j < k; ++j)
+            out[j] = j < static_cast<int>(found.size()) ? found[j] : SpatialHit{ -1, -1, 0.f };
+    }
+
+    // The first item along the ray, or layer -1. The ray is walked a grid cell
+    // at a time, and stops at the first stretch where something is hit.
+    SpatialHit raycast(const Ray& ray, sf::Uint32 mask) const {
+        SpatialHit best = { -1, -1, 0.f };
+        for (float from = 0.f; from < ray.length && best.layer < 0; from += GameConfig::COLLISION_CELL_SIZE) {
+            const float to = std::min(from + GameConfig::COLLISION_CELL_SIZE, ray.length);
+            const sf::Vector2f a = ray.origin + ray.direction * from, b = ray.origin + ray.direction * to;
+            Aabb area;
+            area.left = std::min(a.x, b.x);
+            area.top = std::min(a.y, b.y);
+            area.right = std::max(a.x, b.x);
+            area.bottom = std::max(a.y, b.y);
+            broadphase.query(area, mask, [&](int layer, int index) {
+                const float t = entry(ray, broadphase.bounds(layer, index));
+                const SpatialHit hit = { layer, index, t };
+                if (t >= 0.f && (best.layer < 0 || closer(hit, best)))
+                    best = hit;
+            });
+            if (best.layer >= 0 && best.distance >= to && to < ray.length) // may yet be beaten by an item further along
+                best.layer = best.index = -1;
+        }
+        return best;
+    }
+
+    // Every item overlapping the circle, by layer and index, into 'out'
+    void overlap(const Circle& circle, sf::Uint32 mask, std::vector<SpatialHit>& out) const {
+        out.clear();
+        broadphase.query(square(circle.center, circle.radius), mask, [&](int layer, int index) {
+            const float d = distance(circle.center, broadphase.bounds(layer, index));
+            if (d < circle.radius)
+                out.push_back(SpatialHit{ layer, index, d });
+        });
+        std::sort(out.begin(), out.end(), [](const SpatialHit& a, const SpatialHit& b) {
+            return a.layer != b.layer ? a.layer < b.layer : a.index < b.index;
+        });
+        out.erase(std::unique(out.begin(), out.end(), same), out.end());
+    }
+
+    // Batches: results[q * k + j] for nearest, results[q] for the others
+    void nearest(const std::vector<sf::Vector2f>& points, int k, sf::Uint32 mask, std::vector<SpatialHit>& results) {
+        results.resize(points.size() * k);
+        jobs.parallelFor(0, points.size(), GameConfig::SPATIAL_QUERY_GRAIN, [&](size_t from, size_t to) {
+            // Each query starts a step inside the radius the previous one needed;
+            // queries in a batch tend to see the same density
+            Scratch& own = scratch[JobSystem::currentSlot()];
+            for (size_t q = from; q < to; ++q) {
+                own.radius *= 0.5f;
+                if (own.radius < SEARCH_START)
+                    own.radius = SEARCH_START;
+                nearest(points[q], k, mask, &results[q * k], own);
+            }
+        });
+    }
+    void raycast(const std::vector<Ray>& rays, sf::Uint32 mask, std::vector<SpatialHit>& results) {
+        results.resize(rays.size());
+        jobs.parallelFor(0, rays.size(), GameConfig::SPATIAL_QUERY_GRAIN, [&](size_t from, size_t to) {
+            for (size_t q = from; q < to; ++q)
+                results[q] = raycast(rays[q], mask);
+        });
+    }
+    void overlap(const std::vector<Circle>& circles, sf::Uint32 mask, std::vector<std::vector<SpatialHit>>& results) {
+        results.resize(circles.size());
+        jobs.parallelFor(0, circles.size(), GameConfig::SPATIAL_QUERY_GRAIN, [&](size_t from, size_t to) {
+            for (size_t q = from; q < to; ++q)
+                overlap(circles[q], mask, results[q]);
+        });
+    }
+
+    static float distance(sf::Vector2f p, const Aabb& b) {
+        const float dx = std::max(std::max(b.left - p.x, p.x - b.right), 0.f);
+        const float dy = std::max(std::max(b.top - p.y, p.y - b.bottom), 0.f);
+        return std::sqrt(dx * dx + dy * dy);
+    }
+    // How far along the ray it enters the box (0 if it starts inside), or -1 if it misses
+    static float entry(const Ray& ray, const Aabb& b) {
+        float enter = 0.f, exit = ray.length;
+        if (!slab(ray.origin.x, ray.direction.x, b.left, b.right, enter, exit) ||
+            !slab(ray.origin.y, ray.direction.y, b.top, b.bottom, enter, exit))
+            return -1.f;
+        return enter;
+    }
+
+private:
+    const LayeredBroadphase& broadphase;
+    JobSystem& jobs;
+    std::vector<Scratch> scratch; // one per job system thread
+
+    // The nearest search starts at the first radius and takes everything left,
+    // wherever it is, past the second
+    static constexpr float SEARCH_START = 8.f;
+    static constexpr float SEARCH_LIMIT = 2.f * GameConfig::WINDOW_WIDTH;
+    static const Aabb EVERYWHERE;
+
+    static Aabb square(sf::Vector2f center, float radius) {
+        Aabb b;
+        b.left = center.x - radius;
+        b.top = center.y - radius;
+        b.right = center.x + radius;
+        b.bottom = center.y + radius;
+        return b;
+    }
+    static bool closer(const SpatialHit& a, const SpatialHit& b) {
+        if (a.distance != b.distance)
+            return a.distance < b.distance;
+        return a.layer != b.layer ? a.layer < b.layer : a.index < b.index;
+    }
+    static bool same(const SpatialHit& a, const SpatialHit& b) {
+        return a.layer == b.layer && a.index == b.index;
+    }
+    // Narrows [enter, exit] to where the ray is between lo and hi on one axis
+    static bool slab(float origin, float direction, float lo, float hi, float& enter, float& exit) {
+        if (direction == 0.f)
+            return origin >= lo && origin <= hi;
+        float t0 = (lo - origin) / direction, t1 = (hi - origin) / direction;
+        if (t0 > t1)
+            std::swap(t0, t1);
+        enter = std::max(enter, t0);
+        exit = std::min(exit, t1);
+        return enter <= exit;
+    }
+};
+const Aabb SpatialQueries::EVERYWHERE = SpatialQueries::square(sf::Vector2f(0.f, 0.f), 1e6f);
+
+// --- Pixel Masks ---
+// One bit per pixel, set where a texture is solid, in rows of 64-bit words with
+// bit x % 64 of word x / 64 for column x. Built once per animation frame at load
+// time and only consulted after the boxes overlap, so a pixel-accurate hit costs
+// one AND per word of the overlapping rows.
+class CollisionMask {
+public:
+    int width = 0, height = 0;
+    int words = 0; // per row
+    std::vector<sf::Uint64> rows;
+
+    void build(const sf::Texture& texture) {
+        const sf::Image image = texture.copyToImage();
+        width = static_cast<int>(image.getSize().x);
+        height = static_cast<int>(image.getSize().y);
+        words = (width + 63) / 64;
+        rows.assign(static_cast<size_t>(words) * height, 0);
+        for (int y = 0; y < height; ++y)
+            for (int x = 0; x < width; ++x)
+                if (image.getPixel(x, y).a >= GameConfig::COLLISION_ALPHA_THRESHOLD)
+                    rows[y * words + x / 64] |= sf::Uint64(1) << (x % 64);
+    }
+
+    // Whether a drawn at atA and b drawn at atB share a solid pixel. The offset
+    // between them is rounded to whole pixels.
+    static bool overlap(const CollisionMask& a, sf::Vector2f atA, const CollisionMask& b, sf::Vector2f atB) {
+        const int dx = static_cast<int>(std::lround(atB.x - atA.x));
+        const int dy = static_cast<int>(std::lround(atB.y - atA.y));
+        if (dx >= a.width || dx + b.width <= 0)
+            return false;
+        const int top = std::max(0, dy), bottom = std::min(a.height, dy + b.height);
+        const int firstWord = std::max(0, dx) / 64, lastWord = (std::min(a.width, dx + b.width) - 1) / 64;
+        for (int y = top; y < bottom; ++y) {
+            const sf::Uint64* rowA = &a.rows[y * a.words];
+            const sf::Uint64* rowB = &b.rows[(y - dy) * b.words];
+            for (int w = firstWord; w <= lastWord; ++w)
+                if (rowA[w] & b.bitsAt(rowB, 64 * w - dx))
+                    return true;
+        }
+        return false;
+    }
+
+    bool solid(int x, int y) const {
+        return x >= 0 && y >= 0 && x < width && y < height && ((rows[y * words + x / 64] >> (x % 64)) & 1);
+    }
+
+private:
+    // The 64 bits of a row starting at column 'start'; columns outside the row read as empty
+    sf::Uint64 bitsAt(const sf::Uint64* row, int start) const {
+        if (start <= -64 || start >= words * 64)
+            return 0;
+        if (start < 0)
+            return row[0] << -start;
+        const int w = start / 64, shift = start % 64;
+        sf::Uint64 bits = row[w] >> shift;
+        if (shift != 0 && w + 1 < words)
+            bits |= row[w + 1] << (64 - shift);
+        return bits;
+    }
+};
+
+// Masks of every texture that takes part in collisions, looked up by texture.
+class CollisionMasks {
+public:
+    void add(const sf::Texture& texture) { masks[&texture].build(texture); }
+    void add(const std::vector<sf::Texture>& frames) {
+        for (const sf::Texture& texture : frames)
+            add(texture);
+    }
+    // Whether two sprites share a solid pixel once 'sprite' is moved back by
+    // 'back'. Sprites without a mask count as solid boxes.
+    bool overlap(const sf::Sprite& sprite, sf::Vector2f back, const sf::Sprite& target) const {
+        const CollisionMask* a = of(sprite);
+        const CollisionMask* b = of(target);
+        return !a || !b || CollisionMask::overlap(*a, sprite.getPosition() - back, *b, target.getPosition());
+    }
+    // The same for a sprite turned as 'collider' (see Obb::of): the center of
+    // each solid pixel of its mask is carried through the turn and looked up in
+    // the target's mask.
+    bool overlap(const Obb& collider, const sf::Sprite& sprite, const sf::Sprite& target) const {
+        const CollisionMask* a = of(sprite);
+        const CollisionMask* b = of(target);
+        if (!a || !b)
+            return true;
+        // Where the mask's top left corner lands, relative to the target
+        const sf::Vector2f corner = collider.center - target.getPosition() - collider.axisX * collider.half.x - collider.axisY * collider.half.y;
+        for (int y = 0; y < a->height; ++y) {
+            const sf::Vector2f row = corner + collider.axisY * (y + 0.5f);
+            for (int x = 0; x < a->width; ++x) {
+                if (!a->solid(x, y))
+                    continue;
+                const sf::Vector2f p = row + collider.axisX * (x + 0.5f);
+                if (b->solid(static_cast<int>(std::floor(p.x)), static_cast<int>(std::floor(p.y))))
+                    return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    std::unordered_map<const sf::Texture*, CollisionMask> masks;
+
+    const CollisionMask* of(const sf::Sprite& sprite) const {
+        auto it = masks.find(sprite.getTexture());
+        return it == masks.end() ? nullptr : &it->second;
+    }
+};
+
+// --- OOP Game Class ---
+class SpaceInvadersGame {
+public:
+    enum GameState { START, PLAYING, GAME_OVER, YOU_WON, YOU_LOSE, LEVEL_TRANSITION };
+
+    explicit SpaceInvadersGame(const LaunchOptions& launch = LaunchOptions())
+        : options(launch),
+        gameState(START),
+        scoreFile("scores.txt"),
+        fontSizeTitle(24), fontSizeMain(16), fontSizeSmall(10),
+        health(GameConfig::PLAYER_MAX_HEALTH), score(0), level(1),
+        bossSpawned(false), bossDefeated(false), bossHealth(GameConfig::BOSS_MAX_HEALTH),
+        isShaking(false), shakeDuration(0.f), shakeIntensity(GameConfig::SHAKE_INTENSITY),
+        level1CompleteSoundPlayed(false), level2CompleteSoundPlayed(false),
+        inLevelTransition(false), nextLevel(1), bossMusicStarted(false),
+        level2EnemySpeed(GameConfig::ENEMY_SPEED_LEVEL2), level2SpawnRate(GameConfig::ENEMY_SPAWN_RATE_LEVEL2),
+        level2DoubleSpawnCounter(0), level2MaxEnemies(GameConfig::LEVEL2_MAX_ENEMIES),
+        timeSurvived(0.f), totalKills(0),
+        gameOverSoundPlayed(false), gameOverScoreSaved(false),
+        healthPowerUpTimer(0.f), healthPowerUpNextSpawn(0.f)
+    {
+        if (options.mode == LaunchOptions::REPLAY) {
+            if (!replay.loadFromFile(options.replayFile))
+                std::cerr << "Could not load replay: " << options.replayFile << std::endl;
+        }
+        else {
+            replay.seed = std::random_device{}();
+            replay.flags = options.fixedPoint ? Replay::FIXED_POINT : 0;
+        }
+        FixedMath::enabled = (replay.flags & Replay::FIXED_POINT) != 0;
+        rng.seed(replay.seed);
+        if (options.headless)
+            sf::Listener::setGlobalVolume(0.f);
+        else
+            window.create(sf::VideoMode(GameConfig::WINDOW_WIDTH, GameConfig::WINDOW_HEIGHT), "Simple Space Shooter");
+        simClock.setScale(options.timeScale);
+        loadResources();
+        setupUI();
+        player.setPosition(400.f, 500.f);
+        playerBounds = Aabb::of(player);
+        scheduleNextHealthPowerUp();
+        rebuildHashes();
+    }
+
+    // Replaces the wall clock that paces the simulation thread, e.g. with a
+    // scripted source in soak tests. Must be called before run().
+    void setTimeSource(TimeSource& source) { timeSource = &source; }
+
+    void run() {
+        if (options.mode == LaunchOptions::REPLAY && options.seekSeconds > 0.f)
+            seekReplay(static_cast<sf::Uint64>(options.seekSeconds * GameConfig::SIM_TICKS_PER_SECOND));
+        if (options.headless) {
+            runHeadless();
+        }
+        else {
+            // The simulation runs on its own thread; this one only handles events and draws
+            simRunning = true;
+            std::thread simThread(&SpaceInvadersGame::simulationLoop, this);
+            while (window.isOpen()) {
+                handleEvents();
+                printCommandOutput();
+                if (frames.fetch())
+                    render(frames.readSlot());
+                else
+                    sf::sleep(sf::milliseconds(1));
+            }
+            simRunning = false;
+            simThread.join();
+            printCommandOutput();
+        }
+        finishRun();
+        cleanup();
+    }
+
+private:
+    // Window and state
+    LaunchOptions options;
+    sf::RenderWindow window;
+    GameState gameState;
+    const std::string scoreFile;
+
+    // Fonts and UI
+    sf::Font font;
+    const unsigned int fontSizeTitle, fontSizeMain, fontSizeSmall;
+    sf::Text startText, winText, loseText, scoreText, levelText;
+    sf::Text healthLabelText, healthValueText;
+    sf::RectangleShape healthBarBack, healthBarFront;
+    sf::Text bossHealthLabelText, bossHealthValueText;
+    sf::RectangleShape bossHealthBarBack, bossHealthBarFront;
+    sf::Text highScoreText, transitionText;
+
+    // Game variables
+    int health, score, level;
+    bool bossSpawned, bossDefeated;
+    int bossHealth;
+    int highScore;
+
+    // Sounds
+    sf::SoundBuffer bgBuffer, shootBuffer, explosionBuffer, winBuffer, loseBuffer, levelUpBuffer, levelCompleteBuffer, bossBuffer, healthPowerUpBuffer;
+    sf::Sound backgroundSound, shootSound, explosionSound, winSound, loseSound, levelUpSound, levelCompleteSound, bossSound, healthPowerUpSound;
+
+    // Textures
+    sf::Texture playerTex, enemyTex, bossTex;
+    std::vector<sf::Texture> bulletFrames;
+    std::vector<sf::Texture> level2EnemyFrames;
+    std::vector<sf::Texture> explosionFrames;
+    std::vector<sf::Texture> bossFrames;
+    sf::Texture healthPowerUpTex;
+    CollisionMasks masks; // for the player, enemies, the boss and bullets
+
+    // Entities
+    sf::Sprite player;
+    Aabb playerBounds; // kept in step with the player sprite
+    std::vector<Enemy*> enemies;
+    std::vector<Bullet> bullets;
+    std::vector<Explosion> explosions;
+    Boss boss;
+    std::vector<Bullet> bossBullets;
+    std::vector<HealthPowerUp> healthPowerUps;
+
+    // Parallel update and collision detection
+    struct BulletHit {
+        int powerUp, enemy; // first overlapping powerup / enemy, or -1
+        bool boss;
+        bool consumed;
+    };
+    JobSystem jobs;
+    std::vector<BulletHit> bulletHits;
+    std::vector<sf::Uint8> enemyKilled; // this tick
+    std::vector<Aabb> enemyBounds, powerUpBounds, bossBulletAreas;
+    LayeredBroadphase colliders; // this tick's, by collision layer
+    enum BossBulletOutcome : sf::Uint8 { IN_FLIGHT, HIT_PLAYER, OFFSCREEN };
+    std::vector<sf::Uint8> bossBulletHits;
+
+    // Gameplay events raised during the current tick
+    RingBuffer<GameEvent, GameConfig::EVENT_QUEUE_CAPACITY> events;
+
+    // Timers and random
+    GameClock bossAttackClock, bossSpreadAttackClock, bossMinionSpawnClock;
+    GameRandom rng; // all gameplay randomness, so replays stay deterministic
+    GameClock enemySpawnClock, shootClock, shakeClock, levelTransitionClock, gameTimer, healthPowerUpClock;
+
+    // Camera shake
+    bool isShaking;
+    float shakeDuration, shakeIntensity;
+
+    // Level up/transition
+    bool level1CompleteSoundPlayed, level2CompleteSoundPlayed;
+    bool inLevelTransition;
+    int nextLevel;
+
+    // Boss music
+    bool bossMusicStarted;
+
+    // Level 2 difficulty
+    float level2EnemySpeed, level2SpawnRate;
+    int level2DoubleSpawnCounter, level2MaxEnemies;
+
+    // Stats
+    float timeSurvived;
+    int totalKills;
+
+    // Game over screen
+    bool gameOverSoundPlayed, gameOverScoreSaved;
+
+    // Health PowerUp
+    float healthPowerUpTimer;
+    float healthPowerUpNextSpawn;
+
+    // Replay recording and playback
+    Replay replay;
+    ReplayCursor replayCursor{ replay };
+    InputFrame input;
+    bool replayFinishedReported = false;
+    // Headless runs time collision handling per level, to compare broadphases on real replays
+    sf::Time collisionTime[4];
+    sf::Uint64 collisionTicks[4] = {};
+    GameSnapshot keyframeSnapshot;
+
+    // Desync detection against the digests recorded in the replay
+    StateHash hashes;
+    bool desynced = false;
+    bool desyncExplained = false; // categories reported at the next digest
+    sf::Uint64 desyncTick = 0;
+
+    // Debug quick save (F5) and rollback (F9) in normal play, and --check round trips
+    GameSnapshot quickSave, rollbackScratch;
+    enum { ROUND_TRIP_REPEATS = 100 };
+    double saveMicroseconds = 0.0, restoreMicroseconds = 0.0;
+    int roundTrips = 0, roundTripMismatches = 0;
+
+    // Simulation/render thread split
+    enum SimCommand { QUICK_SAVE, ROLLBACK, SEEK_BACK, SEEK_FORWARD, SEEK_START, TOGGLE_PAUSE, SINGLE_STEP, SLOW_DOWN, SPEED_UP, NORMAL_SPEED };
+    TripleBuffer<RenderFrame> frames;
+    std::atomic<bool> simRunning{ false };
+    std::mutex commandMutex;
+    std::vector<SimCommand> pendingCommands, runningCommands;
+    std::ostringstream commandReport; // written by runCommands on the simulation thread
+    std::string commandOutput; // handed to the render thread to print; guarded by commandMutex
+    sf::Vector2f cameraOffset;
+    TextureAtlas spriteAtlas;
+    SpriteBatch spriteBatch{ spriteAtlas };
+    RenderQueue renderQueue{ spriteBatch };
+    RenderStats renderStats;
+    sf::Text renderStatsText;
+    bool showRenderStats = false;
+
+    // Time warp: scaled, pausable real time drives the simulation thread
+    WallTimeSource wallTime;
+    TimeSource* timeSource = &wallTime;
+    SimulationClock simClock{ wallTime };
+    sf::Text timeScaleText;
+    float hudTimeScale = 1.f;
+    bool hudPaused = false;
+    int hudScore = -1, hudLevel = -1, hudHealth = -1, hudBossHealth = -1, hudHighScore = -1;
+    int hudState = -1, hudKills = -1, hudSecondsSurvived = -1;
+    bool hudShowBossHealth = false;
+    HudLayer hud{ font };
+    sf::Text timeText, killsText, quitText;
+    int scoreCounter = -1, highScoreCounter = -1, healthCounter = -1, bossHealthCounter = -1, timeCounter = -1, killsCounter = -1;
+    int healthBar = -1, bossHealthBar = -1;
+    
+    sf::Texture backgroundTexture;
+    sf::Sprite backgroundSprite;
+    
+  
+    // --- Resource Loading and UI Setup ---
+    void loadResources() {
+        // Font
+        font.loadFromFile("D:/OOP Project/Space Invaders/Space Invaders/assets/main_font.ttf");
+        if (!backgroundTexture.loadFromFile("D:/OOP Project/Space Invaders/Space Invaders/assets/background.png")) {
+            // Error handling if needed
+        }
+        backgroundSprite.setTexture(backgroundTexture);
+        // Sounds
+        bgBuffer.loadFromFile("D:/OOP Project/Space Invaders/Space Invaders/assets/background_music.wav");
+        shootBuffer.loadFromFile("D:/OOP Project/Space Invaders/Space Invaders/assets/shoot.wav");
+        explosionBuffer.loadFromFile("D:/OOP Project/Space Invaders/Space Invaders/assets/explosion.wav");
+        winBuffer.loadFromFile("D:/OOP Project/Space Invaders/Space Invaders/assets/win.wav");
+        loseBuffer.loadFromFile("D:/OOP Project/Space Invaders/Space Invaders/assets/lost.wav");
+        levelUpBuffer.loadFromFile("D:/OOP Project/Space Invaders/Space Invaders/assets/levelup.wav");
+        levelCompleteBuffer.loadFromFile("D:/OOP Project/Space Invaders/Space Invaders/assets/levelcom.wav");
+        bossBuffer.loadFromFile("D:/OOP Project/Space Invaders/Space Invaders/assets/boss.wav");
+        // Health powerup sound (optional, fallback to shoot if not found)
+        if (!healthPowerUpBuffer.loadFromFile("D:/OOP Project/Space Invaders/Space Invaders/assets/explosion.wav")) {
+            healthPowerUpSound.setBuffer(shootBuffer);
+        }
+        else {
+            healthPowerUpSound.setBuffer(healthPowerUpBuffer);
+        }
+
+        backgroundSound.setBuffer(bgBuffer);
+        shootSound.setBuffer(shootBuffer);
+        explosionSound.setBuffer(explosionBuffer);
+        winSound.setBuffer(winBuffer);
+        loseSound.setBuffer(loseBuffer);
+        levelUpSound.setBuffer(levelUpBuffer);
+        levelCompleteSound.setBuffer(levelCompleteBuffer);
+        bossSound.setBuffer(bossBuffer);
+
+        backgroundSound.setLoop(true);
+        backgroundSound.setVolume(40);
+        if (backgroundSound.getStatus() != sf::Sound::Playing)
+            backgroundSound.play();
+
+        bossSound.setLoop(true);
+        bossSound.setVolume(60);
+
+        // Textures
+        playerTex.loadFromFile("D:/OOP Project/Space Invaders/Space Invaders/assets/sprite_ship_3.png");
+        enemyTex.loadFromFile("D:/OOP Project/Space Invaders/Space Invaders/assets/big_boss1.png");
+        bossTex.loadFromFile("D:/OOP Project/Space Invaders/Space Invaders/assets/final_boss_animation/sprite_0.png");
+
+        bulletFrames.resize(5);
+        for (int i = 0; i < 5; ++i) {
+            bulletFrames[i].loadFromFile("D:/OOP Project/Space Invaders/Space Invaders/assets/blaster_player/sprite_" + std::to_string(i) + ".png");
+        }
+        level2EnemyFrames.resize(5);
+        for (int i = 0; i < 5; ++i) {
+            level2EnemyFrames[i].loadFromFile("D:/OOP Project/Space Invaders/Space Invaders/assets/invader_animation_2/sprite_" + std::to_string(i) + ".png");
+        }
+        explosionFrames.resize(GameConfig::EXPLOSION_FRAMES);
+        for (int i = 0; i < GameConfig::EXPLOSION_FRAMES; ++i) {
+            explosionFrames[i].loadFromFile("D:/OOP Project/Space Invaders/Space Invaders/assets/explotion/sprite_" + std::to_string(i) + ".png");
+        }
+        bossFrames.resize(6);
+        for (int i = 0; i < 6; ++i) {
+            bossFrames[i].loadFromFile("D:/OOP Project/Space Invaders/Space Invaders/assets/final_boss_animation/sprite_" + std::to_string(i) + ".png");
+        }
+        // Health powerup texture
+        healthPowerUpTex.loadFromFile("D:/OOP Project/Space Invaders/Space Invaders/assets/health.png");
+        masks.add(playerTex);
+        masks.add(enemyTex);
+        masks.add(level2EnemyFrames);
+        masks.add(bossFrames);
+        masks.add(bulletFrames);
+        spriteAtlas.add(playerTex);
+        spriteAtlas.add(enemyTex);
+        spriteAtlas.add(level2EnemyFrames);
+        spriteAtlas.add(explosionFrames);
+        spriteAtlas.add(bossFrames);
+        spriteAtlas.add(bulletFrames);
+        spriteAtlas.add(healthPowerUpTex);
+        spriteAtlas.build();
+        player.setTexture(playerTex);
+        sf::Vector2u textureSize = backgroundTexture.getSize();
+        backgroundSprite.setScale(
+            static_cast<float>(GameConfig::WINDOW_WIDTH) / textureSize.x,
+            static_cast<float>(GameConfig::WINDOW_HEIGHT) / textureSize.y
+        );
+    }
+
+    void setupUI() {
+        startText = sf::Text("Press SPACE to Start", font, fontSizeTitle);
+        startText.setPosition(220.f, 300.f);
+
+        winText = sf::Text("YOU WON!\nPress R to Restart", font, fontSizeTitle);
+        winText.setFillColor(sf::Color::Green);
+        winText.setPosition(220.f, 250.f);
+
+        loseText = sf::Text("YOU LOSE!\nPress R to Retry", font, fontSizeTitle);
+        loseText.setFillColor(sf::Color::Red);
+        loseText.setPosition(220.f, 250.f);
+
+        scoreText = sf::Text("Score: ", font, fontSizeMain);
+        scoreText.setPosition(10.f, 10.f);
+
+        levelText = sf::Text("Level 1", font, fontSizeMain);
+        levelText.setPosition(10.f, 35.f);
+
+        healthLabelText = sf::Text("Health:", font, fontSizeMain);
+        healthLabelText.setPosition(580.f - healthLabelText.getLocalBounds().width - 10.f, 10.f + (20.f - fontSizeMain) / 2.f);
+
+        // Value texts only give the counters on the bars their size, color and place
+        healthValueText = sf::Text("", font, fontSizeSmall);
+        healthValueText.setFillColor(sf::Color::Black);
+        healthValueText.setPosition(580.f + GameConfig::HEALTH_BAR_WIDTH / 2.f - 10.f, 10.f + GameConfig::HEALTH_BAR_HEIGHT / 2.f - fontSizeSmall / 2.f);
+
+        healthBarBack = sf::RectangleShape(sf::Vector2f(GameConfig::HEALTH_BAR_WIDTH, GameConfig::HEALTH_BAR_HEIGHT));
+        healthBarBack.setFillColor(sf::Color(50, 50, 50));
+        healthBarBack.setPosition(580.f, 10.f);
+
+        healthBarFront = sf::RectangleShape(sf::Vector2f(GameConfig::HEALTH_BAR_WIDTH, GameConfig::HEALTH_BAR_HEIGHT));
+        healthBarFront.setFillColor(sf::Color::Red);
+        healthBarFront.setPosition(580.f, 10.f);
+
+        bossHealthLabelText = sf::Text("Boss:", font, fontSizeMain);
+        bossHealthLabelText.setPosition(580.f - bossHealthLabelText.getLocalBounds().width - 10.f, 40.f + (20.f - fontSizeMain) / 2.f);
+
+        bossHealthValueText = sf::Text("", font, fontSizeSmall);
+        bossHealthValueText.setFillColor(sf::Color::Black);
+        bossHealthValueText.setPosition(580.f + GameConfig::HEALTH_BAR_WIDTH / 2.f - 10.f, 40.f + GameConfig::HEALTH_BAR_HEIGHT / 2.f - fontSizeSmall / 2.f);
+
+        bossHealthBarBack = sf::RectangleShape(sf::Vector2f(GameConfig::HEALTH_BAR_WIDTH, GameConfig::HEALTH_BAR_HEIGHT));
+        bossHealthBarBack.setFillColor(sf::Color(50, 50, 50));
+        bossHealthBarBack.setPosition(580.f, 40.f);
+
+        bossHealthBarFront = sf::RectangleShape(sf::Vector2f(GameConfig::HEALTH_BAR_WIDTH, GameConfig::HEALTH_BAR_HEIGHT));
+        bossHealthBarFront.setFillColor(sf::Color::Blue);
+        bossHealthBarFront.setPosition(580.f, 40.f);
+
+        // Read once here, for the start screen, and again only when a score is saved or the game restarts
+        highScore = getHighScore(scoreFile);
+        highScoreText = sf::Text("High Score: ", font, fontSizeMain);
+        highScoreText.setFillColor(sf::Color::Yellow);
+        highScoreText.setPosition(10.f, 60.f);
+
+        transitionText = sf::Text("", font, fontSizeTitle);
+        transitionText.setFillColor(sf::Color::Yellow);
+        transitionText.setStyle(sf::Text::Bold);
+        transitionText.setPosition(300.f, 250.f);
+
+        timeScaleText = sf::Text("", font, fontSizeMain);
+        timeScaleText.setFillColor(sf::Color::Cyan);
+        timeScaleText.setPosition(10.f, GameConfig::WINDOW_HEIGHT - 30.f);
+
+        timeText = sf::Text("Time Survived: ", font, fontSizeMain);
+        timeText.setFillColor(sf::Color::Cyan);
+        timeText.setPosition(220.f, 320.f);
+
+        killsText = sf::Text("Total Kills: ", font, fontSizeMain);
+        killsText.setFillColor(sf::Color::Magenta);
+        killsText.setPosition(220.f, 350.f);
+
+        quitText = sf::Text("Press Q to Quit", font, fontSizeMain);
+        quitText.setFillColor(sf::Color(200, 200, 200));
+        quitText.setPosition(220.f, 380.f);
+
+        // Small values are scaled down from the main size, so the HUD is at most two draws
+        hud.addPage(fontSizeMain);
+        hud.addPage(fontSizeTitle);
+
+        renderStatsText = sf::Text("", font, fontSizeMain);
+        renderStatsText.setFillColor(sf::Color::Cyan);
+        renderStatsText.setPosition(GameConfig::WINDOW_WIDTH - 330.f, GameConfig::WINDOW_HEIGHT - 30.f);
+    }
+
+    // --- Main Game Loop Methods ---
+    void handleEvents() {
+        sf::Event event;
+        while (window.pollEvent(event)) {
+            if (event.type == sf::Event::Closed)
+                window.close();
+            const int shownState = frames.readSlot().gameState;
+            if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::Q &&
+                (shownState == YOU_WON || shownState == YOU_LOSE))
+                window.close();
+            // Quick save / rollback for debugging; replays must stay in sync with their inputs
+            if (event.type == sf::Event::KeyPressed && options.mode == LaunchOptions::PLAY) {
+                if (event.key.code == sf::Keyboard::F5)
+                    postCommand(QUICK_SAVE);
+                else if (event.key.code == sf::Keyboard::F9)
+                    postCommand(ROLLBACK);
+            }
+            // F3 shows what each frame costs to draw
+            if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::F3)
+                showRenderStats = !showRenderStats;
+            // Time warp: P pauses, '.' steps one tick while paused, [ and ] halve or double the speed, Backspace resets it
+            if (event.type == sf::Event::KeyPressed) {
+                switch (event.key.code) {
+                case sf::Keyboard::P: postCommand(TOGGLE_PAUSE); break;
+                case sf::Keyboard::Period: postCommand(SINGLE_STEP); break;
+                case sf::Keyboard::LBracket: postCommand(SLOW_DOWN); break;
+                case sf::Keyboard::RBracket: postCommand(SPEED_UP); break;
+                case sf::Keyboard::Backspace: postCommand(NORMAL_SPEED); break;
+                default: break;
+                }
+            }
+            // Scrubbing while watching a replay
+            if (event.type == sf::Event::KeyPressed && options.mode == LaunchOptions::REPLAY) {
+                if (event.key.code == sf::Keyboard::Left)
+                    postCommand(SEEK_BACK);
+                else if (event.key.code == sf::Keyboard::Right)
+                    postCommand(SEEK_FORWARD);
+                else if (event.key.code == sf::Keyboard::Home)
+                    postCommand(SEEK_START);
+            }
+        }
+    }
+
+    // --- Simulation Thread ---
+    // Advances whole ticks against the wall clock and publishes a render frame
+    // whenever the state moved on. Input is sampled here, so a slow display()
+    // on the render thread never delays it.
+    void simulationLoop() {
+        simClock.setSource(*timeSource);
+        bool changed = true;
+        while (simRunning) {
+            changed |= runCommands();
+            int steps = simClock.advance(GameConfig::MAX_TICKS_PER_FRAME);
+            for (int i = 0; i < steps; ++i)
+                tick();
+            if (steps > 0 || changed) {
+                buildRenderFrame(frames.writeSlot());
+                frames.publish();
+                changed = false;
+            }
+            sf::sleep(simClock.untilNextTick());
+        }
+    }
+
+    // Requests from the render thread that touch simulation state.
+    void postCommand(SimCommand command) {
+        std::lock_guard<std::mutex> lock(commandMutex);
+        pendingCommands.push_back(command);
+    }
+
+    bool runCommands() {
+        {
+            std::lock_guard<std::mutex> lock(commandMutex);
+            if (pendingCommands.empty())
+                return false;
+            runningCommands.swap(pendingCommands);
+        }
+        const sf::Uint64 step = static_cast<sf::Uint64>(GameConfig::REPLAY_SEEK_STEP * GameConfig::SIM_TICKS_PER_SECOND);
+        for (SimCommand command : runningCommands) {
+            switch (command) {
+            case QUICK_SAVE:
+                saveSnapshot(quickSave);
+                commandReport << "Saved snapshot at tick " << SimTime::ticks << "\n";
+                break;
+            case ROLLBACK:
+                if (!quickSave.isValid())
+                    break;
+                saveSnapshot(rollbackScratch);
+                commandReport << "Rolling back to tick " << quickSave.header().tick << ":\n";
+                GameSnapshot::diff(rollbackScratch, quickSave, commandReport);
+                restoreSnapshot(quickSave);
+                break;
+            case SEEK_BACK: seekReplay(SimTime::ticks > step ? SimTime::ticks - step : 0); break;
+            case SEEK_FORWARD: seekReplay(SimTime::ticks + step); break;
+            case SEEK_START: seekReplay(0); break;
+            case TOGGLE_PAUSE: simClock.setPaused(!simClock.isPaused()); break;
+            case SINGLE_STEP: simClock.step(); break;
+            case SLOW_DOWN: simClock.setScale(simClock.getScale() / 2.f); break;
+            case SPEED_UP: simClock.setScale(simClock.getScale() * 2.f); break;
+            case NORMAL_SPEED: simClock.setScale(1.f); break;
+            }
+        }
+        runningCommands.clear();
+        if (commandReport.tellp() > 0) {
+            std::lock_guard<std::mutex> lock(commandMutex);
+            commandOutput += commandReport.str();
+            commandReport.str(std::string());
+        }
+        return true;
+    }
+
+    // Only the render thread prints while the simulation thread runs, so what
+    // runCommands reports is passed over and printed here.
+    void printCommandOutput() {
+        std::string text;
+        {
+            std::lock_guard<std::mutex> lock(commandMutex);
+            text.swap(commandOutput);
+        }
+        if (!text.empty())
+            std::cout << text << std::flush;
+    }
+
+    // Copies what the render thread needs out of the live game state.
+    void buildRenderFrame(RenderFrame& frame) const {
+        frame.tick = SimTime::ticks;
+        frame.gameState = gameState;
+        frame.viewOffset = cameraOffset;
+        frame.player = { player.getTexture(), player.getPosition() };
+        frame.sprites.clear();
+        frame.effects.clear();
+        if (gameState == PLAYING) {
+            for (const auto& bullet : bullets) frame.sprites.push_back({ bullet.sprite.getTexture(), bullet.sprite.getPosition() });
+            for (const auto* enemy : enemies) frame.sprites.push_back({ enemy->sprite.getTexture(), enemy->sprite.getPosition() });
+            for (const auto& explosion : explosions) frame.effects.push_back({ explosion.sprite.getTexture(), explosion.sprite.getPosition() });
+            // Health powerups are only shown while health is below 50
+            if (health < 50) {
+                for (const auto& h : healthPowerUps)
+                    if (h.active)
+                        frame.sprites.push_back({ h.sprite.getTexture(), h.sprite.getPosition() });
+            }
+            if (bossSpawned && !bossDefeated)
+                frame.sprites.push_back({ boss.sprite.getTexture(), boss.sprite.getPosition() });
+            for (const auto& b : bossBullets) frame.sprites.push_back({ b.sprite.getTexture(), b.sprite.getPosition(), b.rotation() });
+        }
+        frame.score = score;
+        frame.level = level;
+        frame.highScore = highScore;
+        frame.totalKills = totalKills;
+        frame.health = health;
+        frame.bossHealth = boss.health;
+        frame.showBossHealth = bossSpawned && !bossDefeated;
+        frame.timeSurvived = timeSurvived;
+        frame.timeScale = simClock.getScale();
+        frame.paused = simClock.isPaused();
+    }
+
+    // Whole pixels of a health bar from integer math, the same on every build
+    static float barWidth(int value, int max) {
+        return static_cast<float>(static_cast<int>(GameConfig::HEALTH_BAR_WIDTH) * std::max(0, value) / max);
+    }
+    // The HUD belongs to the render thread and only the values that changed are
+    // rewritten: numbers and bars are patched in place, and the HUD is laid out
+    // again only when its text changes.
+    void updateHud(const RenderFrame& frame) {
+        bool relayout = false;
+        if (frame.gameState != hudState || frame.showBossHealth != hudShowBossHealth) {
+            hudState = frame.gameState;
+            hudShowBossHealth = frame.showBossHealth;
+            relayout = true;
+        }
+        if (frame.level != hudLevel) {
+            hudLevel = frame.level;
+            relayout = true;
+            levelText.setString(hudLevel == 1 ? "Level 1" : hudLevel == 2 ? "Level 2" : "Final Boss!");
+            transitionText.setString(hudLevel == 2 ? "Level 2" : hudLevel == 3 ? "Final Level" : "");
+        }
+        if (frame.timeScale != hudTimeScale || frame.paused != hudPaused) {
+            hudTimeScale = frame.timeScale;
+            hudPaused = frame.paused;
+            relayout = true;
+            char buffer[32];
+            snprintf(buffer, sizeof(buffer), "%s x%g", hudPaused ? "PAUSED" : "Speed", hudTimeScale);
+            timeScaleText.setString(hudPaused || hudTimeScale != 1.f ? buffer : "");
+        }
+        if (frame.score != hudScore) {
+            hudScore = frame.score;
+            hud.setNumber(scoreCounter, hudScore);
+        }
+        if (frame.health != hudHealth) {
+            hudHealth = frame.health;
+            healthBarFront.setSize(sf::Vector2f(barWidth(hudHealth, GameConfig::PLAYER_MAX_HEALTH), GameConfig::HEALTH_BAR_HEIGHT));
+            hud.setBar(healthBar, healthBarFront);
+            hud.setNumber(healthCounter, std::max(0, hudHealth));
+        }
+        if (frame.bossHealth != hudBossHealth) {
+            hudBossHealth = frame.bossHealth;
+            bossHealthBarFront.setSize(sf::Vector2f(barWidth(hudBossHealth, GameConfig::BOSS_MAX_HEALTH), GameConfig::HEALTH_BAR_HEIGHT));
+            hud.setBar(bossHealthBar, bossHealthBarFront);
+            hud.setNumber(bossHealthCounter, std::max(0, hudBossHealth));
+        }
+        if (frame.highScore != hudHighScore) {
+            hudHighScore = frame.highScore;
+            hud.setNumber(highScoreCounter, hudHighScore);
+        }
+        if (static_cast<int>(frame.timeSurvived) != hudSecondsSurvived) {
+            hudSecondsSurvived = static_cast<int>(frame.timeSurvived);
+            hud.setClock(timeCounter, hudSecondsSurvived);
+        }
+        if (frame.totalKills != hudKills) {
+            hudKills = frame.totalKills;
+            hud.setNumber(killsCounter, hudKills);
+        }
+        if (relayout)
+            layoutHud(frame);
+    }
+
+    // Bars first, so the values printed on them land on top. Counters follow
+    // their labels and start out with the current values.
+    void layoutHud(const RenderFrame& frame) {
+        const int digits = GameConfig::HUD_COUNTER_LENGTH;
+        hud.clear();
+        scoreCounter = highScoreCounter = healthCounter = bossHealthCounter = timeCounter = killsCounter = -1;
+        healthBar = bossHealthBar = -1;
+        switch (frame.gameState) {
+        case START:
+            hud.add(startText);
+            highScoreCounter = hud.addCounter(highScoreText, hud.add(highScoreText), digits);
+            break;
+        case LEVEL_TRANSITION:
+            hud.add(transitionText);
+            highScoreCounter = hud.addCounter(highScoreText, hud.add(highScoreText), digits);
+            break;
+        case YOU_WON:
+        case YOU_LOSE:
+            hud.add(frame.gameState == YOU_WON ? winText : loseText);
+            scoreCounter = hud.addCounter(scoreText, hud.add(scoreText), digits);
+            highScoreCounter = hud.addCounter(highScoreText, hud.add(highScoreText), digits);
+            timeCounter = hud.addCounter(timeText, hud.add(timeText), digits);
+            killsCounter = hud.addCounter(killsText, hud.add(killsText), digits);
+            hud.add(quitText);
+            break;
+        case PLAYING:
+            hud.addBar(healthBarBack);
+            healthBar = hud.addBar(healthBarFront);
+            hud.add(healthLabelText);
+            healthCounter = hud.addCounter(healthValueText, healthValueText.getPosition(), digits);
+            if (frame.showBossHealth) {
+                hud.addBar(bossHealthBarBack);
+                bossHealthBar = hud.addBar(bossHealthBarFront);
+                hud.add(bossHealthLabelText);
+                bossHealthCounter = hud.addCounter(bossHealthValueText, bossHealthValueText.getPosition(), digits);
+            }
+            scoreCounter = hud.addCounter(scoreText, hud.add(scoreText), digits);
+            hud.add(levelText);
+            highScoreCounter = hud.addCounter(highScoreText, hud.add(highScoreText), digits);
+            break;
+        default: break;
+        }
+        hud.add(timeScaleText);
+        hud.setNumber(scoreCounter, hudScore);
+        hud.setNumber(highScoreCounter, hudHighScore);
+        hud.setNumber(healthCounter, std::max(0, hudHealth));
+        hud.setNumber(bossHealthCounter, std::max(0, hudBossHealth));
+        hud.setClock(timeCounter, hudSecondsSurvived);
+        hud.setNumber(killsCounter, hudKills);
+    }
+
+    // Advances the simulation by exactly one tick, feeding it live or recorded input.
+    void tick() {
+        if (options.mode == LaunchOptions::REPLAY) {
+            if (replayCursor.finished()) {
+                if (!replayFinishedReported) {
+                    printReplaySummary();
+                    replayFinishedReported = true;
+                }
+                return;
+            }
+            captureKeyframe();
+            input = replayCursor.next();
+        }
+        else {
+            captureKeyframe();
+            input = InputFrame::sampleKeyboard();
+            if (options.mode == LaunchOptions::RECORD)
+                replay.append(input);
+        }
+        update();
+        if (options.mode != LaunchOptions::PLAY)
+            checkStateHash();
+        SimTime::ticks++;
+    }
+
+    // Plays the whole replay back without a window, as fast as the CPU allows.
+    void runHeadless() {
+        sf::Clock wallClock;
+        while (!replayCursor.finished()) {
+            tick();
+            if (options.check && SimTime::ticks % replay.keyframeInterval == 0)
+                checkSnapshotRoundTrip();
+        }
+        float seconds = wallClock.getElapsedTime().asSeconds();
+        std::cout << "Simulated " << SimTime::ticks << " ticks in " << seconds << "s";
+        if (seconds > 0.f)
+            std::cout << " (" << static_cast<long long>(SimTime::ticks / seconds) << " ticks/s)";
+        std::cout << std::endl;
+        std::cout << "Collision handling per tick (" << LaunchOptions::nameOf(options.enemyBroadphase()) << "):";
+        for (int lvl = 1; lvl <= 3; ++lvl) {
+            if (collisionTicks[lvl] > 0)
+                std::cout << " level " << lvl << " " << collisionTime[lvl].asMicroseconds() * 1000.0 / collisionTicks[lvl] << " ns";
+        }
+        std::cout << std::endl;
+        printReplaySummary();
+        if (options.check) {
+            std::cout << "Snapshot round trips: " << roundTrips << ", " << roundTripMismatches << " mismatched; save "
+                << saveMicroseconds / (roundTrips * ROUND_TRIP_REPEATS) << " us, restore "
+                << restoreMicroseconds / (roundTrips * ROUND_TRIP_REPEATS) << " us" << std::endl;
+        }
+    }
+
+    // Saves the state, restores it and saves it again, which must give the same
+    // bytes; playback then goes on from the restored state, so any field restore
+    // misses shows up as a desync. Each step is repeated to time it.
+    void checkSnapshotRoundTrip() {
+        sf::Clock clock;
+        for (int i = 0; i < ROUND_TRIP_REPEATS; ++i)
+            saveSnapshot(quickSave);
+        saveMicroseconds += clock.restart().asMicroseconds();
+        for (int i = 0; i < ROUND_TRIP_REPEATS; ++i)
+            restoreSnapshot(quickSave);
+        restoreMicroseconds += clock.getElapsedTime().asMicroseconds();
+        saveSnapshot(rollbackScratch);
+        ++roundTrips;
+        if (!(rollbackScratch == quickSave)) {
+            ++roundTripMismatches;
+            std::cout << "Snapshot round trip differs at tick " << SimTime::ticks << ":\n";
+            GameSnapshot::diff(quickSave, rollbackScratch, std::cout);
+        }
+    }
+
+    void printReplaySummary() {
+        std::cout << "Replay finished at tick " << SimTime::ticks
+            << ": score " << score << ", level " << level << ", health " << health
+            << ", kills " << totalKills << std::endl;
+        if (desynced)
+            std::cout << "State diverged from the recording at tick " << desyncTick << std::endl;
+        else if (options.mode == LaunchOptions::REPLAY && !replay.stateHashes.empty())
+            std::cout << "State matched the recording on every checked tick" << std::endl;
+    }
+
+    void finishRun() {
+        if (options.mode == LaunchOptions::RECORD) {
+            if (replay.saveToFile(options.replayFile))
+                std::cout << "Saved replay (" << replay.tickCount << " ticks) to " << options.replayFile << std::endl;
+            else
+                std::cerr << "Could not save replay: " << options.replayFile << std::endl;
+        }
+    }
+
+    void update() {
+        handleCameraShake();
+
+        switch (gameState) {
+        case START: handleStartScreen(); break;
+        case LEVEL_TRANSITION: handleLevelTransition(); break;
+        case YOU_WON:
+        case YOU_LOSE: handleGameOver(); break;
+        case PLAYING: handleGameplay(); break;
+        default: break;
+        }
+        dispatchEvents();
+    }
+
+    void render(const RenderFrame& frame) {
+        updateHud(frame);
+        renderStats = RenderStats();
+        sf::View view = window.getDefaultView();
+        view.move(frame.viewOffset);
+        window.setView(view);
+        window.clear();
+        renderQueue.submit(RenderQueue::BACKGROUND, { backgroundSprite.getTexture(), backgroundSprite.getPosition(), 0.f, backgroundSprite.getScale() });
+        if (frame.gameState == PLAYING)
+            renderGameplay(frame);
+        hud.submit(renderQueue);
+        renderQueue.draw(window, renderStats);
+        if (showRenderStats) {
+            char buffer[96];
+            snprintf(buffer, sizeof(buffer), "%d draws  %d batches  %d vertices", renderStats.drawCalls + 1, renderStats.batches, renderStats.vertices);
+            renderStatsText.setString(buffer);
+            window.draw(renderStatsText);
+        }
+        window.display();
+    }
+
+    void cleanup() {
+        for (auto* e : enemies) delete e;
+    }
+
+    // --- Camera Shake ---
+    void handleCameraShake() {
+        if (isShaking && shakeClock.getElapsedTime().asSeconds() < shakeDuration) {
+            float offsetX = (rand() % 11 - 5) * shakeIntensity * 0.1f;
+            float offsetY = (rand() % 11 - 5) * shakeIntensity * 0.1f;
+            cameraOffset = sf::Vector2f(offsetX, offsetY);
+        }
+        else {
+            isShaking = false;
+            cameraOffset = sf::Vector2f();
+        }
+    }
+
+    // --- State Handlers ---
+    void handleStartScreen() {
+        gameTimer.restart();
+        totalKills = 0;
+        if (input.isDown(InputFrame::FIRE)) gameState = PLAYING;
+    }
+
+    void handleLevelTransition() {
+        if (levelTransitionClock.getElapsedTime().asSeconds() > 1.0f) {
+            gameState = PLAYING;
+            inLevelTransition = false;
+        }
+    }
+
+    void handleGameOver() {
+        if (!gameOverSoundPlayed) {
+            if (backgroundSound.getStatus() == sf::Sound::Playing)
+                backgroundSound.stop();
+            if (bossSound.getStatus() == sf::Sound::Playing)
+                bossSound.stop();
+            if (gameState == YOU_WON) {
+                if (winSound.getStatus() != sf::Sound::Playing)
+                    winSound.play();
+            }
+            else {
+                if (loseSound.getStatus() != sf::Sound::Playing)
+                    loseSound.play();
+            }
+            gameOverSoundPlayed = true;
+        }
+        if (!gameOverScoreSaved) {
+            if (options.mode != LaunchOptions::REPLAY)
+                appendScoreToFile(scoreFile, score);
+            highScore = getHighScore(scoreFile);
+            gameOverScoreSaved = true;
+            timeSurvived = gameTimer.getElapsedTime().asSeconds();
+        }
+        if (input.isDown(InputFrame::RESTART)) {
+            resetGame();
+            gameOverSoundPlayed = false;
+            gameOverScoreSaved = false;
+        }
+    }
+
+    void handleGameplay() {
+        handlePlayerInput();
+        handleShooting();
+        handleEnemySpawning();
+        handleLevelProgression();
+        handleBossSpawning();
+        updateEntities();
+        handleBossBehavior();
+        if (options.headless) {
+            sf::Clock clock;
+            handleCollisions();
+            collisionTime[std::min(level, 3)] += clock.getElapsedTime();
+            collisionTicks[std::min(level, 3)]++;
+        }
+        else {
+            handleCollisions();
+        }
+        handleBossDefeat();
+        handleHealthPowerUpSpawning();
+        updateHealthPowerUps();
+    }
+
+    // --- Gameplay Logic ---
+    void handlePlayerInput() {
+        if (input.isDown(InputFrame::LEFT) && playerBounds.left > 0) {
+            player.move(-0.5f, 0.f);
+            playerBounds = Aabb::of(player);
+        }
+        if (input.isDown(InputFrame::RIGHT) && playerBounds.right < GameConfig::WINDOW_WIDTH) {
+            player.move(0.5f, 0.f);
+            playerBounds = Aabb::of(player);
+        }
+    }
+
+    void handleShooting() {
+        if (input.isDown(InputFrame::FIRE) && shootClock.getElapsedTime().asMilliseconds() > 200) {
+            sf::Vector2f bulletPos(
+                playerBounds.left + playerBounds.width() / 2.f,
+                playerBounds.top
+            );
+            bulletPos.x -= static_cast<float>(bulletFrames[0].getSize().x) / 2.f;
+            bullets.emplace_back(bulletFrames, bulletPos);
+            hashSpawned(StateHash::BULLETS, bullets.back());
+            if (shootSound.getStatus() != sf::Sound::Playing)
+                shootSound.play();
+            shootClock.restart();
+        }
+    }
+
+    void handleEnemySpawning() {
+        float spawnRate = (level == 1) ? GameConfig::ENEMY_SPAWN_RATE_LEVEL1 :
+            (level == 2) ? level2SpawnRate : GameConfig::ENEMY_SPAWN_RATE_DEFAULT;
+        if (enemySpawnClock.getElapsedTime().asSeconds() > spawnRate && level < 3) {
+            float x = static_cast<float>(rng.nextInt(750));
+            if (level == 2) {
+                int currentLevel2Enemies = 0;
+                for (auto* e : enemies) {
+                    if (dynamic_cast<AnimatedEnemy*>(e)) currentLevel2Enemies++;
+                }
+                if (currentLevel2Enemies < level2MaxEnemies) {
+                    enemies.push_back(new AnimatedEnemy(level2EnemyFrames, sf::Vector2f(x, -50.f), level2EnemySpeed));
+                    hashSpawned(StateHash::ENEMIES, *enemies.back());
+                    level2DoubleSpawnCounter++;
+                    if (level2DoubleSpawnCounter % GameConfig::LEVEL2_DOUBLE_SPAWN_FREQ == 0 && currentLevel2Enemies + 1 < level2MaxEnemies) {
+                        float x2 = static_cast<float>(rng.nextInt(750));
+                        enemies.push_back(new AnimatedEnemy(level2EnemyFrames, sf::Vector2f(x2, -50.f), level2EnemySpeed + GameConfig::LEVEL2_DOUBLE_SPAWN_SPEED_BONUS));
+                        hashSpawned(StateHash::ENEMIES, *enemies.back());
+                    }
+                }
+            }
+            else {
+                enemies.push_back(new Enemy(enemyTex, sf::Vector2f(x, -50.f)));
+                hashSpawned(StateHash::ENEMIES, *enemies.back());
+            }
+            enemySpawnClock.restart();
+        }
+    }
+
+    void handleLevelProgression() {
+        if (level == 1 && score >= GameConfig::LEVEL2_SCORE_THRESHOLD && !inLevelTransition) {
+            level = 2;
+            if (!level1CompleteSoundPlayed) {
+                if (levelUpSound.getStatus() != sf::Sound::Playing)
+                    levelUpSound.play();
+                level1CompleteSoundPlayed = true;
+            }
+            gameState = LEVEL_TRANSITION;
+            levelTransitionClock.restart();
+            inLevelTransition = true;
+        }
+        else if (level == 2 && score >= GameConfig::LEVEL3_SCORE_THRESHOLD && !inLevelTransition) {
+            level = 3;
+            if (!level2CompleteSoundPlayed) {
+                if (levelCompleteSound.getStatus() != sf::Sound::Playing)
+                    levelCompleteSound.play();
+                level2CompleteSoundPlayed = true;
+            }
+            gameState = LEVEL_TRANSITION;
+            levelTransitionClock.restart();
+            inLevelTransition = true;
+            for (auto* e : enemies) delete e;
+            enemies.clear();
+            hashes.set(StateHash::ENEMIES, 0);
+        }
+    }
+
+    void handleBossSpawning() {
+        if (level == 3 && !bossSpawned) {
+            boss = Boss(bossFrames);
+            boss.fixedPosition.set(boss.sprite, boss.bounds, sf::Vector2f(300.f, -100.f));
+            boss.health = GameConfig::BOSS_MAX_HEALTH;
+            bossHealth = GameConfig::BOSS_MAX_HEALTH;
+            bossSpawned = true;
+            if (backgroundSound.getStatus() == sf::Sound::Playing)
+                backgroundSound.stop();
+            if (bossSound.getStatus() != sf::Sound::Playing)
+                bossSound.play();
+            bossMusicStarted = true;
+            bossAttackClock.restart();
+            bossSpreadAttackClock.restart();
+            bossMinionSpawnClock.restart();
+            hashBoss();
+        }
+        if ((gameState == YOU_WON || gameState == YOU_LOSE) && bossMusicStarted) {
+            if (bossSound.getStatus() == sf::Sound::Playing)
+                bossSound.stop();
+            bossMusicStarted = false;
+        }
+    }
+
+    // Entities only touch their own state while updating, so each list is split
+    // across the job system.
+    void updateEntities() {
+        const size_t grain = GameConfig::JOB_GRAIN_SIZE;
+        jobs.parallelFor(0, bullets.size(), grain, [this](size_t from, size_t to) {
+            for (size_t i = from; i < to; ++i)
+                bullets[i].update();
+        });
+        jobs.parallelFor(0, enemies.size(), grain, [this](size_t from, size_t to) {
+            for (size_t i = from; i < to; ++i)
+                enemies[i]->update();
+        });
+        jobs.parallelFor(0, explosions.size(), grain, [this](size_t from, size_t to) {
+            for (size_t i = from; i < to; ++i)
+                explosions[i].update();
+        });
+        jobs.parallelFor(0, bossBullets.size(), grain, [this](size_t from, size_t to) {
+            for (size_t i = from; i < to; ++i)
+                bossBullets[i].update();
+        });
+    }
+
+    void handleBossBehavior() {
+        if (bossSpawned && !bossDefeated) {
+            boss.update();
+            if (boss.sprite.getPosition().y < GameConfig::BOSS_DESCEND_Y)
+                boss.fixedPosition.move(boss.sprite, boss.bounds, sf::Vector2f(0.f, GameConfig::BOSS_DESCEND_SPEED));
+            boss.updatePhase();
+
+            float bossBulletSpeed = GameConfig::BOSS_BULLET_SPEED;
+            float bossAttackInterval = GameConfig::BOSS_ATTACK_INTERVAL;
+            if (boss.phase == Boss::PHASE2) {
+                bossBulletSpeed = GameConfig::BOSS_BULLET_SPEED_PHASE2;
+                bossAttackInterval = GameConfig::BOSS_ATTACK_INTERVAL_PHASE2;
+            }
+            else if (boss.phase == Boss::PHASE3) {
+                bossBulletSpeed = GameConfig::BOSS_BULLET_SPEED_PHASE3;
+                bossAttackInterval = GameConfig::BOSS_ATTACK_INTERVAL_PHASE3;
+            }
+
+            if (bossAttackClock.getElapsedTime().asSeconds() > bossAttackInterval) {
+                sf::Vector2f bossPos = boss.sprite.getPosition() + sf::Vector2f(40.f, 60.f);
+                bossBullets.emplace_back(bulletFrames, bossPos, sf::Vector2f(0.f, bossBulletSpeed));
+                hashSpawned(StateHash::BOSS_BULLETS, bossBullets.back());
+                bossAttackClock.restart();
+            }
+
+            if (boss.phase >= Boss::PHASE2 && bossSpreadAttackClock.getElapsedTime().asSeconds() > GameConfig::BOSS_SPREAD_BULLET_INTERVAL) {
+                sf::Vector2f bossPos = boss.sprite.getPosition() + sf::Vector2f(40.f, 60.f);
+                int n = GameConfig::BOSS_SPREAD_BULLET_COUNT;
+                float spread = GameConfig::BOSS_SPREAD_BULLET_ANGLE;
+                float angleStart = 90.f - spread / 2.f;
+                float angleStep = spread / (n - 1);
+                for (int i = 0; i < n; ++i) {
+                    sf::Vector2f vel;
+                    if (FixedMath::enabled) {
+                        sf::Int32 angle = FixedMath::fromFloat(angleStart) + i * (FixedMath::fromFloat(spread) / (n - 1));
+                        sf::Int32 speed = FixedMath::fromFloat(bossBulletSpeed);
+                        vel = sf::Vector2f(FixedMath::toFloat(FixedMath::mul(FixedMath::cosDeg(angle), speed)),
+                            FixedMath::toFloat(FixedMath::mul(FixedMath::sinDeg(angle), speed)));
+                    }
+                    else {
+                        float angle = angleStart + i * angleStep;
+                        float rad = angle * 3.14159265f / 180.f;
+                        vel = sf::Vector2f(std::cos(rad) * bossBulletSpeed, std::sin(rad) * bossBulletSpeed);
+                    }
+                    bossBullets.emplace_back(bulletFrames, bossPos, vel);
+                    hashSpawned(StateHash::BOSS_BULLETS, bossBullets.back());
+                }
+                bossSpreadAttackClock.restart();
+            }
+
+            if (boss.phase == Boss::PHASE3 && bossMinionSpawnClock.getElapsedTime().asSeconds() > GameConfig::BOSS_MINION_SPAWN_INTERVAL) {
+                int minionCount = 1 + rng.nextInt(2);
+                for (int i = 0; i < minionCount; ++i) {
+                    float minionX = boss.sprite.getPosition().x + 20.f + rng.nextInt(60) - 30.f;
+                    minionX = std::max(0.f, std::min(minionX, (float)(GameConfig::WINDOW_WIDTH - 40)));
+                    enemies.push_back(new AnimatedEnemy(level2EnemyFrames, sf::Vector2f(minionX, boss.sprite.getPosition().y + 80.f), level2EnemySpeed + 0.1f));
+                    hashSpawned(StateHash::ENEMIES, *enemies.back());
+                }
+                bossMinionSpawnClock.restart();
+            }
+
+        }
+    }
+
+    // Bullet hits on the boss are resolved with the other collisions
+    void handleBossDefeat() {
+        if (bossSpawned && !bossDefeated && boss.health <= 0) {
+            if (boss.sprite.getPosition().y > GameConfig::WINDOW_HEIGHT) {
+                explosions.emplace_back(explosionFrames, boss.sprite.getPosition());
+                hashSpawned(StateHash::EXPLOSIONS, explosions.back());
+            }
+            bossDefeated = true;
+            gameState = YOU_WON;
+        }
+    }
+
+    static bool isOffscreen(const Bullet& b) {
+        return b.sprite.getPosition().y < GameConfig::BULLET_OFFSCREEN_Y;
+    }
+    static bool isBossBulletOffscreen(const Bullet& b) {
+        sf::Vector2f pos = b.sprite.getPosition();
+        return pos.y > GameConfig::WINDOW_HEIGHT || pos.x < 0 || pos.x > GameConfig::WINDOW_WIDTH;
+    }
+
+    // Bullets that left the screen are dropped together with the ones that hit
+    // something. Slow straight ones are out of play once offscreen, but any
+    // other bullet may have hit something on its way out, so it is still tested.
+    void handleCollisions() {
+        explosions.erase(std::remove_if(explosions.begin(), explosions.end(),
+            [this](const Explosion& e) {
+                if (e.finished)
+                    hashRemoved(StateHash::EXPLOSIONS, e);
+                return e.finished;
+            }), explosions.end());
+
+        // Hit detection only reads positions, so it runs on the job system: each
+        // bullet asks the broadphase for the layers a player shot interacts with,
+        // and records whether it hit the boss, the first powerup it overlaps and
+        // the enemy it reaches first. Every hit is then resolved serially in bullet
+        // order: a bullet takes at most one target, the boss before a powerup
+        // before an enemy, and one whose target an earlier bullet already took
+        // moves on to the next it reaches. Killed enemies are removed in one batch.
+        buildColliders();
+        bulletHits.resize(bullets.size());
+        enemyKilled.assign(enemies.size(), 0);
+        jobs.parallelFor(0, bullets.size(), GameConfig::JOB_GRAIN_SIZE, [this](size_t from, size_t to) {
+            for (size_t i = from; i < to; ++i) {
+                const Bullet::Sweep sweep = bullets[i].sweep();
+                const bool offscreen = isOffscreen(bullets[i]);
+                // Only the boss, which descends from above, is left to hit past the top
+                const sf::Uint32 layers = offscreen && !sweep.crosses ? CollisionLayers::bit(CollisionLayers::BOSS)
+                    : CollisionLayers::MATRIX[CollisionLayers::PLAYER_SHOT];
+                bulletHits[i] = findTargets(bullets[i], sweep, layers);
+                bulletHits[i].consumed = offscreen;
+            }
+        });
+
+        bool bossHit = false;
+        for (size_t i = 0; i < bullets.size(); ++i) {
+            BulletHit& hit = bulletHits[i];
+            // --- Boss collision ---
+            if (hit.boss) {
+                boss.health -= GameConfig::BOSS_HIT_DAMAGE;
+                bossHealth -= GameConfig::BOSS_HIT_DAMAGE;
+                emit(GameEvent::HIT, boss.sprite.getPosition(), GameConfig::BOSS_HIT_DAMAGE);
+                bossHit = true;
+                hit.consumed = true;
+                continue;
+            }
+            // --- Health PowerUp collision with bullets ---
+            int h = hit.powerUp;
+            if (h >= 0 && !healthPowerUps[h].active) // already taken by an earlier bullet
+                h = findTargets(bullets[i], bullets[i].sweep(), CollisionLayers::bit(CollisionLayers::POWER_UP), h + 1).powerUp;
+            if (h >= 0) {
+                emit(GameEvent::POWERUP_COLLECTED, healthPowerUps[h].sprite.getPosition(), GameConfig::HEALTH_POWERUP_AMOUNT);
+                // Replenish health
+                health += GameConfig::HEALTH_POWERUP_AMOUNT;
+                if (health > GameConfig::PLAYER_MAX_HEALTH)
+                    health = GameConfig::PLAYER_MAX_HEALTH;
+                // Remove bullet and powerup
+                healthPowerUps[h].active = false;
+                hit.consumed = true;
+                continue;
+            }
+            // --- Enemy collision ---
+            int j = hit.enemy;
+            if (j >= 0 && enemyKilled[j]) // already destroyed by an earlier bullet
+                j = findTargets(bullets[i], bullets[i].sweep(), CollisionLayers::bit(CollisionLayers::ENEMY)).enemy;
+            if (j >= 0) {
+                emit(GameEvent::KILL, enemies[j]->sprite.getPosition(), 10);
+                enemyKilled[j] = 1;
+                hit.consumed = true;
+            }
+        }
+        if (bossHit)
+            boss.stateHash.update(StateHash::of(boss));
+        size_t kept = 0;
+        for (size_t j = 0; j < enemies.size(); ++j) {
+            if (enemyKilled[j]) {
+                hashRemoved(StateHash::ENEMIES, *enemies[j]);
+                delete enemies[j];
+            }
+            else {
+                enemies[kept++] = enemies[j];
+            }
+        }
+        enemies.resize(kept);
+        kept = 0;
+        for (size_t i = 0; i < bullets.size(); ++i) {
+            if (!bulletHits[i].consumed) {
+                if (kept != i)
+                    bullets[kept] = std::move(bullets[i]);
+                kept++;
+            }
+            else {
+                hashRemoved(StateHash::BULLETS, bullets[i]);
+            }
+        }
+        bullets.erase(bullets.begin() + kept, bullets.end());
+
+        // Boss bullets against the player: the areas the bullets swept become the
+        // enemy shot layer and the player queries it, so they are tested a block
+        // at a time and only the few that come near get the exact swept and pixel tests.
+        bossBulletHits.resize(bossBullets.size());
+        bossBulletAreas.resize(bossBullets.size());
+        jobs.parallelFor(0, bossBullets.size(), GameConfig::JOB_GRAIN_SIZE, [this](size_t from, size_t to) {
+            for (size_t i = from; i < to; ++i) {
+                bossBulletAreas[i] = bossBullets[i].sweep().area();
+                bossBulletHits[i] = isBossBulletOffscreen(bossBullets[i]) ? OFFSCREEN : IN_FLIGHT;
+            }
+        });
+        colliders.buildList(CollisionLayers::ENEMY_SHOT, bossBulletAreas.data(), bossBulletAreas.size());
+        colliders.query(playerBounds, CollisionLayers::MATRIX[CollisionLayers::PLAYER], [this](int layer, int i) {
+            switch (layer) {
+            case CollisionLayers::ENEMY_SHOT: {
+                const Bullet& bullet = bossBullets[i];
+                const Bullet::Sweep sweep = bullet.sweep();
+                if (!(bossBulletHits[i] == OFFSCREEN && !sweep.crosses) && impact(bullet, sweep, playerBounds, player) >= 0.f)
+                    bossBulletHits[i] = HIT_PLAYER;
+                break;
+            }
+            }
+        });
+        kept = 0;
+        for (size_t i = 0; i < bossBullets.size(); ++i) {
+            if (bossBulletHits[i] == HIT_PLAYER) {
+                emit(GameEvent::PLAYER_DAMAGED, bossBullets[i].sprite.getPosition(), GameConfig::BOSS_BULLET_DAMAGE, GameEvent::BOSS_BULLET);
+                health -= GameConfig::BOSS_BULLET_DAMAGE;
+                if (health <= 0) gameState = YOU_LOSE;
+            }
+            if (bossBulletHits[i] == IN_FLIGHT) {
+                if (kept != i)
+                    bossBullets[kept] = std::move(bossBullets[i]);
+                kept++;
+            }
+            else {
+                hashRemoved(StateHash::BOSS_BULLETS, bossBullets[i]);
+            }
+        }
+        bossBullets.erase(bossBullets.begin() + kept, bossBullets.end());
+        for (auto it = enemies.begin(); it != enemies.end();) {
+            if ((*it)->sprite.getPosition().y > GameConfig::WINDOW_HEIGHT) {
+                int damage = (level == 1) ? GameConfig::ENEMY_DAMAGE_LEVEL1 :
+                    (level == 2) ? GameConfig::ENEMY_DAMAGE_LEVEL2 : GameConfig::ENEMY_DAMAGE_DEFAULT;
+                emit(GameEvent::PLAYER_DAMAGED, (*it)->sprite.getPosition(), damage, GameEvent::ENEMY_ESCAPED);
+                hashRemoved(StateHash::ENEMIES, **it);
+                delete* it;
+                it = enemies.erase(it);
+                health -= damage;
+                if (health <= 0) gameState = YOU_LOSE;
+            }
+            else ++it;
+        }
+        // Remove inactive health powerups
+        healthPowerUps.erase(
+            std::remove_if(healthPowerUps.begin(), healthPowerUps.end(),
+                [this](const HealthPowerUp& h) {
+                    if (!h.active)
+                        hashRemoved(StateHash::POWERUPS, h);
+                    return !h.active;
+                }),
+            healthPowerUps.end()
+        );
+    }
+
+    // --- Gameplay Event Handling ---
+    void emit(GameEvent::Type type, sf::Vector2f position, int amount, GameEvent::Source source = GameEvent::NONE) {
+        if (events.full())
+            dispatchEvents();
+        GameEvent e;
+        e.type = type;
+        e.source = source;
+        e.amount = static_cast<sf::Int16>(amount);
+        e.x = position.x;
+        e.y = position.y;
+        events.push(e);
+    }
+
+    // Runs once at the end of every tick: each system walks the whole batch, then it is dropped.
+    void dispatchEvents() {
+        if (events.empty())
+            return;
+        applyScoreEvents();
+        playEventSounds();
+        spawnEventEffects();
+        events.clear();
+    }
+
+    void applyScoreEvents() {
+        for (size_t i = 0; i < events.size(); ++i) {
+            if (events[i].type == GameEvent::KILL) {
+                score += events[i].amount;
+                totalKills++;
+            }
+        }
+        if (score > highScore)
+            highScore = score;
+    }
+
+    // Each sound starts at most once per batch, however many events asked for it.
+    void playEventSounds() {
+        bool explosion = false, powerUp = false;
+        for (size_t i = 0; i < events.size(); ++i) {
+            const GameEvent& e = events[i];
+            if (e.type == GameEvent::HIT || e.type == GameEvent::KILL || e.source == GameEvent::ENEMY_ESCAPED)
+                explosion = true;
+            else if (e.type == GameEvent::POWERUP_COLLECTED)
+                powerUp = true;
+        }
+        if (explosion && explosionSound.getStatus() != sf::Sound::Playing)
+            explosionSound.play();
+        if (powerUp && healthPowerUpSound.getStatus() != sf::Sound::Playing)
+            healthPowerUpSound.play();
+    }
+
+    void spawnEventEffects() {
+        for (size_t i = 0; i < events.size(); ++i) {
+            const GameEvent& e = events[i];
+            if (e.type == GameEvent::KILL || e.source == GameEvent::ENEMY_ESCAPED) {
+                explosions.emplace_back(explosionFrames, sf::Vector2f(e.x, e.y));
+                hashSpawned(StateHash::EXPLOSIONS, explosions.back());
+                isShaking = true;
+                shakeDuration = GameConfig::SHAKE_DURATION;
+                shakeClock.restart();
+            }
+            else if (e.type == GameEvent::HIT) {
+                isShaking = true;
+                shakeClock.restart();
+            }
+        }
+    }
+
+    // Bins this tick's colliders by layer. A new kind of entity gets a layer and
+    // a row in CollisionLayers::MATRIX, is added here and handled in findTargets.
+    void buildColliders() {
+        colliders.clear();
+        enemyBounds.resize(enemies.size());
+        for (size_t j = 0; j < enemies.size(); ++j)
+            enemyBounds[j] = enemies[j]->bounds;
+        switch (options.enemyBroadphase()) {
+        case LaunchOptions::SORT_AND_SWEEP:
+            colliders.buildSweep(CollisionLayers::ENEMY, enemyBounds, enemies);
+            break;
+        case LaunchOptions::QUADTREE:
+            colliders.buildTree(CollisionLayers::ENEMY, enemyBounds, enemies);
+            break;
+        default:
+            colliders.buildGrid(CollisionLayers::ENEMY, enemyBounds);
+            break;
+        }
+        powerUpBounds.resize(healthPowerUps.size());
+        for (size_t h = 0; h < healthPowerUps.size(); ++h)
+            powerUpBounds[h] = healthPowerUps[h].bounds;
+        colliders.buildList(CollisionLayers::POWER_UP, powerUpBounds.data(), powerUpBounds.size());
+        if (bossSpawned && !bossDefeated)
+            colliders.buildList(CollisionLayers::BOSS, &boss.bounds, 1);
+    }
+
+    // What the bullet hit this tick on the given layers: the boss, the first
+    // active powerup from 'firstPowerUp' on, and the enemy not yet killed that
+    // it reaches first.
+    BulletHit findTargets(const Bullet& bullet, const Bullet::Sweep& sweep, sf::Uint32 layers, int firstPowerUp = 0) const {
+        BulletHit hit = { -1, -1, false, false };
+        float enemyTime = 0.f;
+        colliders.query(sweep.area(), layers, [&](int layer, int index) {
+            switch (layer) {
+            case CollisionLayers::BOSS:
+                hit.boss = hit.boss || impact(bullet, sweep, boss.bounds, boss.sprite) >= 0.f;
+                break;
+            case CollisionLayers::POWER_UP:
+                if (index >= firstPowerUp && (hit.powerUp < 0 || index < hit.powerUp) && healthPowerUps[index].active && sweep.hits(powerUpBounds[index]))
+                    hit.powerUp = index;
+                break;
+            case CollisionLayers::ENEMY: {
+                if (enemyKilled[index])
+                    break;
+                const float t = impact(bullet, sweep, enemyBounds[index], enemies[index]->sprite);
+                if (t >= 0.f && (hit.enemy < 0 || t < enemyTime || (t == enemyTime && index < hit.enemy))) {
+                    hit.enemy = index;
+                    enemyTime = t;
+                }
+                break;
+            }
+            }
+        });
+        return hit;
+    }
+
+    // When this tick the bullet hits a target, as in Bullet::Sweep::timeOfImpact.
+    // Upright bullets are confirmed on pixel masks. Oriented ones are first
+    // rejected by the separating axis test of their collider, so only they pay
+    // for it, and then confirmed on their mask turned the same way.
+    float impact(const Bullet& bullet, const Bullet::Sweep& sweep, const Aabb& target, const sf::Sprite& targetSprite) const {
+        if (bullet.oriented()) {
+            return sweep.timeOfImpact(target, [&](sf::Vector2f back) {
+                const Obb collider = bullet.collider(back);
+                return collider.intersects(target) && masks.overlap(collider, bullet.sprite, targetSprite);
+            });
+        }
+        return sweep.timeOfImpact(target, [&](sf::Vector2f back) { return masks.overlap(bullet.sprite, back, targetSprite); });
+    }
+
+    // --- Health PowerUp Spawning and Update ---
+    void handleHealthPowerUpSpawning() {
+        // Only spawn health powerup if health is below 50
+        if (health < 50) {
+            float elapsed = healthPowerUpClock.getElapsedTime().asSeconds();
+            if (elapsed > healthPowerUpNextSpawn) {
+                float x = static_cast<float>(rng.nextInt(GameConfig::WINDOW_WIDTH - 40) + 20);
+                healthPowerUps.emplace_back(healthPowerUpTex, sf::Vector2f(x, -40.f), GameConfig::HEALTH_POWERUP_SPEED);
+                hashSpawned(StateHash::POWERUPS, healthPowerUps.back());
+                healthPowerUpClock.restart();
+                scheduleNextHealthPowerUp();
+            }
+        }
+    }
+    void updateHealthPowerUps() {
+        for (auto& h : healthPowerUps) {
+            if (h.active)
+                h.update();
+        }
+    }
+    void scheduleNextHealthPowerUp() {
+        healthPowerUpNextSpawn = rng.nextFloat(GameConfig::HEALTH_POWERUP_SPAWN_MIN, GameConfig::HEALTH_POWERUP_SPAWN_MAX);
+        healthPowerUpClock.restart();
+    }
+
+    // --- Rendering ---
+    void renderGameplay(const RenderFrame& frame) {
+        renderQueue.submit(RenderQueue::ENTITIES, frame.player);
+        for (const auto& s : frame.sprites)
+            renderQueue.submit(RenderQueue::ENTITIES, s);
+        for (const auto& s : frame.effects)
+            renderQueue.submit(RenderQueue::FX, s);
+    }
+
+    // --- Replay Keyframes and Seeking ---
+    // Stores the state at the start of this tick if it falls on a keyframe boundary.
+    // Keyframes missing from a loaded replay are filled in as playback reaches them.
+    void captureKeyframe() {
+        if (options.mode == LaunchOptions::PLAY || SimTime::ticks % replay.keyframeInterval != 0)
+            return;
+        size_t index = static_cast<size_t>(SimTime::ticks / replay.keyframeInterval);
+        if (replay.hasKeyframe(index))
+            return;
+        saveSnapshot(keyframeSnapshot);
+        replay.storeKeyframe(index, keyframeSnapshot.data);
+    }
+
+    // Jumps playback to any tick by restoring the closest keyframe at or before it
+    // and simulating the rest, so a seek never costs more than one keyframe interval.
+    void seekReplay(sf::Uint64 targetTick) {
+        targetTick = std::min<sf::Uint64>(targetTick, replay.tickCount);
+        size_t index = static_cast<size_t>(targetTick / replay.keyframeInterval);
+        while (index > 0 && !replay.hasKeyframe(index))
+            index--;
+        sf::Uint64 keyTick = static_cast<sf::Uint64>(index) * replay.keyframeInterval;
+        if (SimTime::ticks > targetTick || SimTime::ticks < keyTick) {
+            if (!replay.loadKeyframe(index, keyframeSnapshot.data) || !restoreSnapshot(keyframeSnapshot)) {
+                std::cerr << "Replay keyframe " << index << " is corrupt" << std::endl;
+                return;
+            }
+            replayCursor.seek(SimTime::ticks);
+        }
+        float volume = sf::Listener::getGlobalVolume();
+        sf::Listener::setGlobalVolume(0.f);
+        while (SimTime::ticks < targetTick && !replayCursor.finished())
+            tick();
+        sf::Listener::setGlobalVolume(volume);
+        replayFinishedReported = replayCursor.finished() && replayFinishedReported;
+    }
+
+    // --- State Snapshots ---
+    // Everything the simulation depends on. UI, sounds and the high score are
+    // derived from it and rebuilt after restoring.
+    void saveSnapshot(GameSnapshot& snap) const {
+        snap.prepare(bullets.size(), enemies.size(), explosions.size(), bossBullets.size(), healthPowerUps.size());
+        GameSnapshot::Header& h = snap.header();
+        h.tick = SimTime::ticks;
+        h.rngState = rng.state;
+        h.rngInc = rng.inc;
+        h.bossAttackClock = bossAttackClock.getStartTick();
+        h.bossSpreadAttackClock = bossSpreadAttackClock.getStartTick();
+        h.bossMinionSpawnClock = bossMinionSpawnClock.getStartTick();
+        h.enemySpawnClock = enemySpawnClock.getStartTick();
+        h.shootClock = shootClock.getStartTick();
+        h.shakeClock = shakeClock.getStartTick();
+        h.levelTransitionClock = levelTransitionClock.getStartTick();
+        h.gameTimer = gameTimer.getStartTick();
+        h.healthPowerUpClock = healthPowerUpClock.getStartTick();
+        boss.saveState(h.boss);
+        h.playerX = player.getPosition().x;
+        h.playerY = player.getPosition().y;
+        h.shakeDuration = shakeDuration;
+        h.level2EnemySpeed = level2EnemySpeed;
+        h.level2SpawnRate = level2SpawnRate;
+        h.timeSurvived = timeSurvived;
+        h.healthPowerUpTimer = healthPowerUpTimer;
+        h.healthPowerUpNextSpawn = healthPowerUpNextSpawn;
+        h.gameState = gameState;
+        h.health = health;
+        h.score = score;
+        h.level = level;
+        h.bossHealth = bossHealth;
+        h.nextLevel = nextLevel;
+        h.level2DoubleSpawnCounter = level2DoubleSpawnCounter;
+        h.level2MaxEnemies = level2MaxEnemies;
+        h.totalKills = totalKills;
+        h.bossSpawned = bossSpawned;
+        h.bossDefeated = bossDefeated;
+        h.isShaking = isShaking;
+        h.inLevelTransition = inLevelTransition;
+        h.bossMusicStarted = bossMusicStarted;
+        h.level1CompleteSoundPlayed = level1CompleteSoundPlayed;
+        h.level2CompleteSoundPlayed = level2CompleteSoundPlayed;
+        h.gameOverSoundPlayed = gameOverSoundPlayed;
+        h.gameOverScoreSaved = gameOverScoreSaved;
+
+        Bullet::State* bulletStates = snap.bullets();
+        for (size_t i = 0; i < bullets.size(); ++i) bullets[i].saveState(bulletStates[i]);
+        Enemy::State* enemyStates = snap.enemies();
+        for (size_t i = 0; i < enemies.size(); ++i) enemies[i]->saveState(enemyStates[i]);
+        Explosion::State* explosionStates = snap.explosions();
+        for (size_t i = 0; i < explosions.size(); ++i) explosions[i].saveState(explosionStates[i]);
+        Bullet::State* bossBulletStates = snap.bossBullets();
+        for (size_t i = 0; i < bossBullets.size(); ++i) bossBullets[i].saveState(bossBulletStates[i]);
+        HealthPowerUp::State* powerUpStates = snap.healthPowerUps();
+        for (size_t i = 0; i < healthPowerUps.size(); ++i) healthPowerUps[i].saveState(powerUpStates[i]);
+    }
+
+    // Entity containers are resized in place and existing enemies are reused
+    // when their type matches, so rolling back keeps allocations to a minimum.
+    bool restoreSnapshot(const GameSnapshot& snap) {
+        if (!snap.isValid())
+            return false;
+        const GameSnapshot::Header& h = snap.header();
+        SimTime::ticks = h.tick;
+        rng.state = h.rngState;
+        rng.inc = h.rngInc;
+        bossAttackClock.setStartTick(h.bossAttackClock);
+        bossSpreadAttackClock.setStartTick(h.bossSpreadAttackClock);
+        bossMinionSpawnClock.setStartTick(h.bossMinionSpawnClock);
+        enemySpawnClock.setStartTick(h.enemySpawnClock);
+        shootClock.setStartTick(h.shootClock);
+        shakeClock.setStartTick(h.shakeClock);
+        levelTransitionClock.setStartTick(h.levelTransitionClock);
+        gameTimer.setStartTick(h.gameTimer);
+        healthPowerUpClock.setStartTick(h.healthPowerUpClock);
+        if (h.bossSpawned && !boss.frames)
+            boss = Boss(bossFrames);
+        boss.loadState(h.boss);
+        player.setPosition(h.playerX, h.playerY);
+        playerBounds = Aabb::of(player);
+        shakeDuration = h.shakeDuration;
+        level2EnemySpeed = h.level2EnemySpeed;
+        level2SpawnRate = h.level2SpawnRate;
+        timeSurvived = h.timeSurvived;
+        healthPowerUpTimer = h.healthPowerUpTimer;
+        healthPowerUpNextSpawn = h.healthPowerUpNextSpawn;
+        gameState = static_cast<GameState>(h.gameState);
+        health = h.health;
+        score = h.score;
+        level = h.level;
+        bossHealth = h.bossHealth;
+        nextLevel = h.nextLevel;
+        level2DoubleSpawnCounter = h.level2DoubleSpawnCounter;
+        level2MaxEnemies = h.level2MaxEnemies;
+        totalKills = h.totalKills;
+        bossSpawned = h.bossSpawned != 0;
+        bossDefeated = h.bossDefeated != 0;
+        isShaking = h.isShaking != 0;
+        inLevelTransition = h.inLevelTransition != 0;
+        bossMusicStarted = h.bossMusicStarted != 0;
+        level1CompleteSoundPlayed = h.level1CompleteSoundPlayed != 0;
+        level2CompleteSoundPlayed = h.level2CompleteSoundPlayed != 0;
+        gameOverSoundPlayed = h.gameOverSoundPlayed != 0;
+        gameOverScoreSaved = h.gameOverScoreSaved != 0;
+
+        bullets.resize(h.bulletCount, Bullet(bulletFrames, sf::Vector2f()));
+        const Bullet::State* bulletStates = snap.bullets();
+        for (size_t i = 0; i < bullets.size(); ++i) bullets[i].loadState(bulletStates[i]);
+
+        for (size_t i = h.enemyCount; i < enemies.size(); ++i) delete enemies[i];
+        enemies.resize(h.enemyCount, nullptr);
+        const Enemy::State* enemyStates = snap.enemies();
+        for (size_t i = 0; i < enemies.size(); ++i) {
+            bool animated = enemyStates[i].animated != 0;
+            if (!enemies[i] || (dynamic_cast<AnimatedEnemy*>(enemies[i]) != nullptr) != animated) {
+                delete enemies[i];
+                if (animated)
+                    enemies[i] = new AnimatedEnemy(level2EnemyFrames, sf::Vector2f(), 0.f);
+                else
+                    enemies[i] = new Enemy(enemyTex, sf::Vector2f());
+            }
+            enemies[i]->loadState(enemyStates[i]);
+        }
+
+        explosions.resize(h.explosionCount, Explosion(explosionFrames, sf::Vector2f()));
+        const Explosion::State* explosionStates = snap.explosions();
+        for (size_t i = 0; i < explosions.size(); ++i) explosions[i].loadState(explosionStates[i]);
+
+        bossBullets.resize(h.bossBulletCount, Bullet(bulletFrames, sf::Vector2f()));
+        const Bullet::State* bossBulletStates = snap.bossBullets();
+        for (size_t i = 0; i < bossBullets.size(); ++i) bossBullets[i].loadState(bossBulletStates[i]);
+
+        healthPowerUps.resize(h.healthPowerUpCount, HealthPowerUp(healthPowerUpTex, sf::Vector2f(), 0.f));
+        const HealthPowerUp::State* powerUpStates = snap.healthPowerUps();
+        for (size_t i = 0; i < healthPowerUps.size(); ++i) healthPowerUps[i].loadState(powerUpStates[i]);
+
+        if (score > highScore)
+            highScore = score;
+        rebuildHashes();
+        return true;
+    }
+
+    // --- State Hash Tracking ---
+    // Adds a spawned entity's record and position to its category's part; from
+    // then on the entity updates both shares itself.
+    template <typename T>
+    void hashSpawned(StateHash::Category category, T& entity) {
+        hashes.add(category, entity.stateHash, StateHash::of(entity));
+        hashes.add(category, entity.fixedPosition.hash, StateHash::ofPosition(entity));
+    }
+    void hashSpawned(StateHash::Category category, Explosion& explosion) {
+        hashes.add(category, explosion.stateHash, StateHash::of(explosion));
+    }
+    template <typename T>
+    void hashRemoved(StateHash::Category category, const T& entity) {
+        hashes.remove(category, entity.stateHash);
+        hashes.remove(category, entity.fixedPosition.hash);
+    }
+    void hashRemoved(StateHash::Category category, const Explosion& explosion) {
+        hashes.remove(category, explosion.stateHash);
+    }
+
+    // Recomputes every part, for when the whole state was replaced.
+    void rebuildHashes() {
+        hashes = StateHash();
+        for (auto& b : bullets) hashSpawned(StateHash::BULLETS, b);
+        for (auto* e : enemies) hashSpawned(StateHash::ENEMIES, *e);
+        for (auto& e : explosions) hashSpawned(StateHash::EXPLOSIONS, e);
+        for (auto& b : bossBullets) hashSpawned(StateHash::BOSS_BULLETS, b);
+        for (auto& h : healthPowerUps) hashSpawned(StateHash::POWERUPS, h);
+        hashBoss();
+    }
+
+    // For a boss that was replaced or reset from outside its own updates.
+    void hashBoss() {
+        hashes.set(StateHash::BOSS, 0);
+        hashSpawned(StateHash::BOSS, boss);
+    }
+
+    // Per tick, only the player and the scalars every outcome flows through are
+    // hashed. Timers and counters are left to keyframes: a diverging timer shows
+    // up in the RNG state or the entity parts as soon as it triggers a spawn.
+    void hashFixedState() {
+        hashes.set(StateHash::PLAYER, StateHash::ofRecord(player.getPosition()));
+        const sf::Uint64 gameRecord[] = { rng.state, StateHash::word(gameState, health),
+            StateHash::word(score, level), StateHash::word(bossHealth, totalKills) };
+        hashes.set(StateHash::GAME, StateHash::ofRecord(gameRecord));
+    }
+
+    // After every tick, records the folded hash (and on keyframe ticks the
+    // per-category digest), or compares it with the recorded one. The first
+    // tick that differs is reported, and the categories at the next recorded
+    // digest; digests are only looked at once a mismatch was seen.
+    void checkStateHash() {
+        const sf::Uint64 tick = SimTime::ticks;
+        hashFixedState();
+        if (options.mode == LaunchOptions::RECORD) {
+            replay.stateHashes.push_back(hashes.fold());
+            if (tick % replay.keyframeInterval == 0)
+                replay.categoryDigests.push_back(hashes.digest());
+            return;
+        }
+        if (!desynced && tick < replay.stateHashes.size() && hashes.fold() != replay.stateHashes[tick]) {
+            desynced = true;
+            desyncTick = tick;
+            std::cerr << "Desync at tick " << desyncTick << std::endl;
+        }
+        if (desynced && !desyncExplained && tick % replay.keyframeInterval == 0) {
+            const size_t index = static_cast<size_t>(tick / replay.keyframeInterval);
+            if (index < replay.categoryDigests.size()) {
+                desyncExplained = true;
+                const std::string categories = StateHash::mismatch(replay.categoryDigests[index], hashes.digest());
+                std::cerr << "By tick " << tick << ": " << (categories.empty() ? "no single category" : categories) << " diverged from the recording" << std::endl;
+            }
+        }
+    }
+
+    // --- Reset ---
+    void resetGame() {
+        health = GameConfig::PLAYER_MAX_HEALTH;
+        score = 0;
+        level = 1;
+        for (auto* e : enemies) delete e;
+        enemies.clear();
+        bullets.clear();
+        explosions.clear();
+        hashes.set(StateHash::ENEMIES, 0);
+        hashes.set(StateHash::BULLETS, 0);
+        hashes.set(StateHash::EXPLOSIONS, 0);
+        bossSpawned = false;
+        bossDefeated = false;
+        bossHealth = GameConfig::BOSS_MAX_HEALTH;
+        boss.health = GameConfig::BOSS_MAX_HEALTH;
+        hashBoss();
+        level1CompleteSoundPlayed = false;
+        level2CompleteSoundPlayed = false;
+        bossMusicStarted = false;
+        gameTimer.restart();
+        totalKills = 0;
+        highScore = getHighScore(scoreFile);
+        if (backgroundSound.getStatus() != sf::Sound::Playing)
+            backgroundSound.play();
+        // Reset health powerups
+        healthPowerUps.clear();
+        hashes.set(StateHash::POWERUPS, 0);
+        scheduleNextHealthPowerUp();
+        gameState = PLAYING;
+    }
+};
+
+// --- Benchmarks ---
+// "--bench": one player-sized box against N bullet-sized boxes spread over the
+// playfield, timing the plain loop over Aabb against every overlap kernel this CPU has.
+void runOverlapBenchmark() {
+    struct Kernel { const char* name; OverlapKernel::Function function; };
+    std::vector<Kernel> kernels = { { "scalar columns", OverlapKernel::scalar } };
+#ifdef SPACE_INVADERS_X86
+    kernels.push_back({ "sse2", OverlapKernel::sse2 });
+    if (OverlapKernel::hasAvx2())
+        kernels.push_back({ "avx2", OverlapKernel::avx2 });
+#endif
+    Aabb probe;
+    probe.left = 380.f;
+    probe.top = 480.f;
+    probe.right = 430.f;
+    probe.bottom = 530.f;
+    GameRandom rng;
+    rng.seed(1);
+    for (size_t n : { 1000, 10000, 100000 }) {
+        std::vector<Aabb> boxes(n);
+        AabbColumns columns;
+        columns.resize(n);
+        for (size_t i = 0; i < n; ++i) {
+            boxes[i].left = rng.nextFloat(0.f, static_cast<float>(GameConfig::WINDOW_WIDTH));
+            boxes[i].top = rng.nextFloat(0.f, static_cast<float>(GameConfig::WINDOW_HEIGHT));
+            boxes[i].right = boxes[i].left + 8.f;
+            boxes[i].bottom = boxes[i].top + 16.f;
+            columns.set(i, boxes[i]);
+        }
+        const size_t rounds = std::max<size_t>(1, 50000000 / n);
+
+        sf::Clock clock;
+        size_t expected = 0;
+        for (size_t r = 0; r < rounds; ++r)
+            for (size_t i = 0; i < n; ++i)
+                expected += probe.intersects(boxes[i]);
+        const double scalarNs = clock.getElapsedTime().asMicroseconds() * 1000.0 / (static_cast<double>(rounds) * n);
+        std::cout << n << " boxes: scalar " << scalarNs << " ns/box";
+
+        for (const Kernel& kernel : kernels) {
+            clock.restart();
+            size_t hits = 0;
+            for (size_t r = 0; r < rounds; ++r) {
+                for (size_t first = 0; first < n; first += AabbColumns::BLOCK)
+                    OverlapKernel::forEachBit(kernel.function(probe, columns, first) & OverlapKernel::firstBits(n - first), [&hits](size_t) { hits++; });
+            }
+            const double ns = clock.getElapsedTime().asMicroseconds() * 1000.0 / (static_cast<double>(rounds) * n);
+            std::cout << ", " << kernel.name << " " << ns << " ns/box (" << scalarNs / ns << "x)";
+            if (hits != expected)
+                std::cout << " MISMATCH";
+        }
+        std::cout << std::endl;
+    }
+}
+
+// Wall time per query of one batch of 'count' queries
+template <typename F>
+double timeQueries(size_t count, F run) {
+    sf::Clock clock;
+    run();
+    return clock.getElapsedTime().asMicroseconds() * 1000.0 / count;
+}
+
+// "--bench", continued: boss spread volleys fanning out from one point, the densest
+// pattern the game makes, against the player and a column of player shots. Each
+// broadphase is brought up to date and queried every tick, as in handleCollisions.
+void runClusterBenchmark() {
+    struct Shot {
+        Aabb box;
+        sf::Vector2f direction;
+        float distance;
+    };
+    const sf::Vector2f origin(400.f, 160.f);
+    const float reach = 60.f, speed = 0.05f;
+    const int ticks = 200, queries = 256;
+    const float angleStart = 90.f - GameConfig::BOSS_SPREAD_BULLET_ANGLE / 2.f;
+    const float angleStep = GameConfig::BOSS_SPREAD_BULLET_ANGLE / (GameConfig::BOSS_SPREAD_BULLET_COUNT - 1);
+    for (size_t n : { 1000, 4000, 16000 }) {
+        std::vector<Shot> shots(n);
+        std::vector<Shot*> owners(n);
+        std::vector<float> start(n);
+        GameRandom rng;
+        rng.seed(7);
+        for (size_t i = 0; i < n; ++i) {
+            const float rad = (angleStart + (i % GameConfig::BOSS_SPREAD_BULLET_COUNT) * angleStep) * 3.14159265f / 180.f;
+            shots[i].direction = sf::Vector2f(std::cos(rad), std::sin(rad));
+            start[i] = rng.nextFloat(0.f, reach);
+            owners[i] = &shots[i];
+        }
+        std::vector<Aabb> probes(queries);
+        for (Aabb& probe : probes) {
+            probe.left = rng.nextFloat(300.f, 500.f);
+            probe.top = rng.nextFloat(0.f, static_cast<float>(GameConfig::WINDOW_HEIGHT));
+            probe.right = probe.left + 8.f;
+            probe.bottom = probe.top + 16.f;
+        }
+        probes[0].left = 380.f; // the player
+        probes[0].top = 480.f;
+        probes[0].right = 430.f;
+        probes[0].bottom = 530.f;
+
+        std::cout << n << " clustered boss bullets:";
+        size_t expected = 0;
+        for (LaunchOptions::Broadphase kind : { LaunchOptions::GRID, LaunchOptions::SORT_AND_SWEEP, LaunchOptions::QUADTREE }) {
+            LayeredBroadphase broadphase;
+            std::vector<Aabb> bounds(n);
+            for (size_t i = 0; i < n; ++i)
+                shots[i].distance = start[i];
+            // The grid may report an item once per cell, so each probe counts it once
+            std::vector<int> seenBy(n, -1);
+            int probe = 0;
+            sf::Clock clock;
+            size_t hits = 0;
+            for (int t = 0; t < ticks; ++t) {
+                for (size_t i = 0; i < n; ++i) {
+                    Shot& shot = shots[i];
+                    shot.distance += speed;
+                    if (shot.distance > reach)
+                        shot.distance -= reach;
+                    shot.box.left = origin.x + shot.direction.x * shot.distance;
+                    shot.box.top = origin.y + shot.direction.y * shot.distance;
+                    shot.box.right = shot.box.left + 8.f;
+                    shot.box.bottom = shot.box.top + 16.f;
+                    bounds[i] = shot.box;
+                }
+                broadphase.clear();
+                if (kind == LaunchOptions::GRID)
+                    broadphase.buildGrid(CollisionLayers::ENEMY_SHOT, bounds);
+                else if (kind == LaunchOptions::SORT_AND_SWEEP)
+                    broadphase.buildSweep(CollisionLayers::ENEMY_SHOT, bounds, owners);
+                else
+                    broadphase.buildTree(CollisionLayers::ENEMY_SHOT, bounds, owners);
+                for (const Aabb& area : probes) {
+                    broadphase.query(area, CollisionLayers::bit(CollisionLayers::ENEMY_SHOT), [&](int, int i) {
+                        if (seenBy[i] != probe) {
+                            seenBy[i] = probe;
+                            hits++;
+                        }
+                    });
+                    probe++;
+                }
+            }
+            const double us = clock.getElapsedTime().asMicroseconds() / static_cast<double>(ticks);
+            std::cout << (kind == LaunchOptions::GRID ? " " : ", ") << LaunchOptions::nameOf(kind) << " " << us << " us/tick";
+            if (kind == LaunchOptions::GRID)
+                expected = hits;
+            else if (hits != expected)
+                std::cout << " MISMATCH";
+        }
+        std::cout << std::endl;
+    }
+}
+
+// "--bench", continued: 10k bullet-sized boxes over the playfield and a batch of
+// 10k of each spatial query, timed per query against scanning every box, with
+// the answers checked against the scan.
+void runSpatialQueryBenchmark() {
+    const size_t n = 10000, queries = 10000;
+    const int k = 4;
+    const int layer = CollisionLayers::ENEMY;
+    const sf::Uint32 mask = CollisionLayers::bit(layer);
+    GameRandom rng;
+    rng.seed(11);
+    std::vector<Aabb> bounds(n);
+    std::vector<const Aabb*> owners(n);
+    for (size_t i = 0; i < n; ++i) {
+        bounds[i].left = rng.nextFloat(0.f, static_cast<float>(GameConfig::WINDOW_WIDTH));
+        bounds[i].top = rng.nextFloat(0.f, static_cast<float>(GameConfig::WINDOW_HEIGHT));
+        bounds[i].right = bounds[i].left + 8.f;
+        bounds[i].bottom = bounds[i].top + 16.f;
+        owners[i] = &bounds[i];
+    }
+    std::vector<sf::Vector2f> points(queries);
+    std::vector<Ray> rays(queries);
+    std::vector<Circle> circles(queries);
+    for (size_t q = 0; q < queries; ++q) {
+        points[q] = sf::Vector2f(rng.nextFloat(0.f, static_cast<float>(GameConfig::WINDOW_WIDTH)), rng.nextFloat(0.f, static_cast<float>(GameConfig::WINDOW_HEIGHT)));
+        const float angle = rng.nextFloat(0.f, 6.2831853f);
+        rays[q].origin = points[q];
+        rays[q].direction = sf::Vector2f(std::cos(angle), std::sin(angle));
+        rays[q].length = static_cast<float>(GameConfig::WINDOW_WIDTH);
+        circles[q].center = points[q];
+        circles[q].radius = 20.f;
+    }
+
+    JobSystem jobs;
+    std::vector<SpatialHit> linearNearest(queries * k), linearRays(queries);
+    std::vector<std::vector<SpatialHit>> linearCircles(queries);
+    const double linearNs[3] = {
+        timeQueries(queries, [&] {
+            jobs.parallelFor(0, queries, GameConfig::SPATIAL_QUERY_GRAIN, [&](size_t from, size_t to) {
+                std::vector<SpatialHit> all(n);
+                for (size_t q = from; q < to; ++q) {
+                    for (size_t i = 0; i < n; ++i)
+                        all[i] = SpatialHit{ layer, static_cast<int>(i), SpatialQueries::distance(points[q], bounds[i]) };
+                    std::partial_sort(all.begin(), all.begin() + k, all.end(), [](const SpatialHit& a, const SpatialHit& b) {
+                        return a.distance != b.distance ? a.distance < b.distance : a.index < b.index;
+                    });
+                    std::copy(all.begin(), all.begin() + k, linearNearest.begin() + q * k);
+                }
+            });
+        }),
+        timeQueries(queries, [&] {
+            jobs.parallelFor(0, queries, GameConfig::SPATIAL_QUERY_GRAIN, [&](size_t from, size_t to) {
+                for (size_t q = from; q < to; ++q) {
+                    SpatialHit best = { -1, -1, 0.f };
+                    for (size_t i = 0; i < n; ++i) {
+                        const float t = SpatialQueries::entry(rays[q], bounds[i]);
+                        if (t >= 0.f && (best.layer < 0 || t < best.distance))
+                            best = SpatialHit{ layer, static_cast<int>(i), t };
+                    }
+                    linearRays[q] = best;
+                }
+            });
+        }),
+        timeQueries(queries, [&] {
+            jobs.parallelFor(0, queries, GameConfig::SPATIAL_QUERY_GRAIN, [&](size_t from, size_t to) {
+                for (size_t q = from; q < to; ++q) {
+                    linearCircles[q].clear();
+                    for (size_t i = 0; i < n; ++i) {
+                        const float d = SpatialQueries::distance(circles[q].center, bounds[i]);
+                        if (d < circles[q].radius)
+                            linearCircles[q].push_back(SpatialHit{ layer, static_cast<int>(i), d });
+                    }
+                }
+            });
+        }),
+    };
+    std::cout << n << " boxes, per query: nearest " << k << " / raycast / circle" << std::endl;
+    std::cout << "  linear scan: " << linearNs[0] << " / " << linearNs[1] << " / " << linearNs[2] << " ns" << std::endl;
+
+    for (LaunchOptions::Broadphase kind : { LaunchOptions::GRID, LaunchOptions::SORT_AND_SWEEP, LaunchOptions::QUADTREE }) {
+        LayeredBroadphase broadphase;
+        if (kind == LaunchOptions::GRID)
+            broadphase.buildGrid(layer, bounds);
+        else if (kind == LaunchOptions::SORT_AND_SWEEP)
+            broadphase.buildSweep(layer, bounds, owners);
+        else
+            broadphase.buildTree(layer, bounds, owners);
+        SpatialQueries spatial(broadphase, jobs);
+        std::vector<SpatialHit> nearest, hits;
+        std::vector<std::vector<SpatialHit>> overlaps;
+        const double nearestNs = timeQueries(queries, [&] { spatial.nearest(points, k, mask, nearest); });
+        const double raycastNs = timeQueries(queries, [&] { spatial.raycast(rays, mask, hits); });
+        const double circleNs = timeQueries(queries, [&] { spatial.overlap(circles, mask, overlaps); });
+        bool same = true;
+        for (size_t q = 0; q < queries; ++q) {
+            for (int j = 0; j < k; ++j)
+                same = same && nearest[q * k + j].index == linearNearest[q * k + j].index;
+            same = same && hits[q].index == linearRays[q].index && overlaps[q].size() == linearCircles[q].size();
+            for (size_t j = 0; same && j < overlaps[q].size(); ++j)
+                same = overlaps[q][j].index == linearCircles[q][j].index;
+        }
+        std::cout << "  " << LaunchOptions::nameOf(kind) << ": " << nearestNs << " / " << raycastNs << " / " << circleNs << " ns"
+            << " (" << linearNs[0] / nearestNs << "x / " << linearNs[1] / raycastNs << "x / " << linearNs[2] / circleNs << "x)"
+            << (same ? "" : " MISMATCH") << std::endl;
+    }
+}
+
+// --- Self-checks ---
+// "--check" without a replay: each check runs a fast path against a plain
+// reference on generated cases, prints how many it ran and returns false on any mismatch.
+
+// Bullets moved through parallelFor must end up in the same state with 1, 2, 4
+// and 8 threads, and each tick must hand every index to exactly one job.
+bool runJobSystemCheck() {
+    std::vector<sf::Texture> frames(2);
+    for (sf::Texture& frame : frames)
+        frame.create(8, 16);
+    const size_t count = 50000;
+    const int ticks = 100;
+    const sf::Uint64 startTick = SimTime::ticks;
+    std::vector<Bullet::State> reference;
+    bool passed = true;
+    std::cout << "Job system: " << count << " bullets for " << ticks << " ticks on";
+    for (unsigned threads : { 1u, 2u, 4u, 8u }) {
+        JobSystem jobs(threads - 1);
+        SimTime::ticks = 0;
+        GameRandom rng;
+        rng.seed(30);
+        std::vector<Bullet> bullets;
+        bullets.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            const sf::Vector2f position(rng.nextFloat(0.f, 800.f), rng.nextFloat(0.f, 600.f));
+            const sf::Vector2f velocity(i % 2 ? rng.nextFloat(-1.f, 1.f) : 0.f, rng.nextFloat(-2.f, 2.f));
+            bullets.emplace_back(frames, position, velocity);
+        }
+        std::vector<std::atomic<int>> visits(count);
+        for (int t = 0; t < ticks; ++t, ++SimTime::ticks) {
+            jobs.parallelFor(0, count, GameConfig::JOB_GRAIN_SIZE, [&](size_t from, size_t to) {
+                for (size_t i = from; i < to; ++i) {
+                    bullets[i].update();
+                    visits[i].fetch_add(1, std::memory_order_relaxed);
+                }
+            });
+        }
+        std::vector<Bullet::State> states(count); // zeroed, padding included, for memcmp
+        for (size_t i = 0; i < count; ++i)
+            bullets[i].saveState(states[i]);
+        bool same = reference.empty() || std::memcmp(states.data(), reference.data(), count * sizeof(Bullet::State)) == 0;
+        for (size_t i = 0; i < count; ++i)
+            same = same && visits[i].load() == ticks;
+        if (reference.empty())
+            reference.swap(states);
+        std::cout << " " << threads << (same ? "" : " MISMATCH");
+        passed = passed && same;
+    }
+    std::cout << " threads" << std::endl;
+    SimTime::ticks = startTick;
+    return passed;
+}
+
+// Boxes of random sizes moving up to 300 px in a tick past a random target: the
+// swept test must hit whenever sampling the move every 1/32 px finds an overlap.
+// A box moving straight by less than its own size only tests where it ends up,
+// which is enough if it already touched the target where it started, as the
+// tick before tested that.
+bool runSweepCheck() {
+    GameRandom rng;
+    rng.seed(33);
+    const int cases = 200000;
+    int hits = 0, tunneled = 0;
+    for (int c = 0; c < cases; ++c) {
+        Aabb target;
+        target.left = rng.nextFloat(300.f, 400.f);
+        target.top = rng.nextFloat(300.f, 400.f);
+        target.right = target.left + rng.nextFloat(1.f, 90.f);
+        target.bottom = target.top + rng.nextFloat(1.f, 70.f);
+        const float width = rng.nextFloat(1.f, 16.f), height = rng.nextFloat(1.f, 32.f);
+        const float length = rng.nextFloat(0.5f, 300.f), angle = rng.nextFloat(0.f, 6.2831853f);
+        const sf::Vector2f moved(length * std::cos(angle), length * std::sin(angle));
+        // A point the move passes through, near the target
+        const sf::Vector2f via(rng.nextFloat(target.left - width - 10.f, target.right + 10.f), rng.nextFloat(target.top - height - 10.f, target.bottom + 10.f));
+        const sf::Vector2f end = via + moved * rng.nextFloat(0.f, 1.f);
+        Aabb bounds;
+        bounds.left = end.x;
+        bounds.top = end.y;
+        bounds.right = end.x + width;
+        bounds.bottom = end.y + height;
+        const Bullet::Sweep sweep = Bullet::Sweep::of(bounds, moved);
+        // The box at time t of the tick
+        auto at = [&](float t) {
+            const sf::Vector2f back = moved * (1.f - t);
+            Aabb a = bounds;
+            a.left -= back.x;
+            a.right -= back.x;
+            a.top -= back.y;
+            a.bottom -= back.y;
+            return a;
+        };
+        const int samples = static_cast<int>(std::ceil(std::max(std::abs(moved.x), std::abs(moved.y)) * 32.f));
+        bool sampled = false;
+        for (int k = 1; k <= samples && !sampled; ++k)
+            sampled = at(static_cast<float>(k) / samples).intersects(target);
+        const bool swept = sweep.hits(target);
+        const Aabb start = at(0.f);
+        const bool startTouches = start.left <= target.right && target.left <= start.right && start.top <= target.bottom && target.top <= start.bottom;
+        if (sampled && !swept && (sweep.crosses || !startTouches))
+            tunneled++;
+        hits += swept;
+    }
+    std::cout << "Swept hits: " << cases << " moves, " << hits << " hits, " << tunneled << " tunneled" << (tunneled ? " MISMATCH" : "") << std::endl;
+    return tunneled == 0;
+}
+
+CollisionMask blankMask(int width, int height) {
+    CollisionMask mask;
+    mask.width = width;
+    mask.height = height;
+    mask.words = (width + 63) / 64;
+    mask.rows.assign(static_cast<size_t>(mask.words) * height, 0);
+    return mask;
+}
+
+// A mask of the given size with one in 2^sparseness of its pixels solid
+CollisionMask randomMask(GameRandom& rng, int width, int height, int sparseness) {
+    CollisionMask mask = blankMask(width, height);
+    for (int y = 0; y < height; ++y) {
+        for (int w = 0; w < mask.words; ++w) {
+            sf::Uint64 bits = ~sf::Uint64(0);
+            for (int k = 0; k < sparseness; ++k)
+                bits &= (sf::Uint64(rng.next()) << 32) | rng.next();
+            // No bits past the end of the row
+            const int used = std::min(64, width - 64 * w);
+            mask.rows[y * mask.words + w] = used == 64 ? bits : bits & ((sf::Uint64(1) << used) - 1);
+        }
+    }
+    return mask;
+}
+
+// Random masks up to 150 px wide, so rows span several words, at random
+// fractional offsets: the word-wise overlap must agree with testing every
+// pixel of one mask against the other at the rounded offset.
+bool runMaskCheck() {
+    GameRandom rng;
+    rng.seed(39);
+    const int cases = 200000;
+    int hits = 0, mismatches = 0;
+    for (int c = 0; c < cases; ++c) {
+        const CollisionMask a = randomMask(rng, 1 + rng.nextInt(150), 1 + rng.nextInt(40), 1 + rng.nextInt(5));
+        const CollisionMask b = randomMask(rng, 1 + rng.nextInt(150), 1 + rng.nextInt(40), 1 + rng.nextInt(5));
+        const sf::Vector2f atA(rng.nextFloat(0.f, 300.f), rng.nextFloat(0.f, 100.f));
+        const sf::Vector2f atB(atA.x + rng.nextFloat(-b.width - 2.f, a.width + 2.f), atA.y + rng.nextFloat(-b.height - 2.f, a.height + 2.f));
+        const int dx = static_cast<int>(std::lround(atB.x - atA.x)), dy = static_cast<int>(std::lround(atB.y - atA.y));
+        bool brute = false;
+        for (int y = 0; y < b.height && !brute; ++y)
+            for (int x = 0; x < b.width && !brute; ++x)
+                brute = b.solid(x, y) && a.solid(x + dx, y + dy);
+        if (CollisionMask::overlap(a, atA, b, atB) != brute)
+            mismatches++;
+        hits += brute;
+    }
+    std::cout << "Mask overlap: " << cases << " pairs, " << hits << " overlapping, " << mismatches << " mismatched" << (mismatches ? " MISMATCH" : "") << std::endl;
+    return mismatches == 0;
+}
+
+// Masked bullets making fast or diagonal moves past a masked target. Sampling
+// each move every 1/32 px finds the first time the boxes overlap and the masks
+// agree; the time of impact must hit whenever that does, no more than one
+// pixel of the move later, and only at a time that really is a hit.
+bool runTimeOfImpactCheck() {
+    GameRandom rng;
+    rng.seed(40);
+    const int cases = 100000;
+    const float slack = 1.f / 1024.f; // px, for slab times that round onto an edge
+    int moves = 0, hits = 0, mismatches = 0;
+    for (int c = 0; c < cases; ++c) {
+        const CollisionMask bullet = randomMask(rng, 1 + rng.nextInt(16), 1 + rng.nextInt(32), 1 + rng.nextInt(3));
+        const CollisionMask target = randomMask(rng, 8 + rng.nextInt(80), 8 + rng.nextInt(60), 1 + rng.nextInt(3));
+        const sf::Vector2f targetAt(rng.nextFloat(300.f, 400.f), rng.nextFloat(300.f, 400.f));
+        Aabb targetBounds;
+        targetBounds.left = targetAt.x;
+        targetBounds.top = targetAt.y;
+        targetBounds.right = targetAt.x + target.width;
+        targetBounds.bottom = targetAt.y + target.height;
+        const float length = rng.nextFloat(0.5f, 300.f), angle = rng.nextFloat(0.f, 6.2831853f);
+        const sf::Vector2f moved(length * std::cos(angle), length * std::sin(angle));
+        const sf::Vector2f via(rng.nextFloat(targetBounds.left - bullet.width - 10.f, targetBounds.right + 10.f),
+            rng.nextFloat(targetBounds.top - bullet.height - 10.f, targetBounds.bottom + 10.f));
+        const sf::Vector2f end = via + moved * rng.nextFloat(0.f, 1.f);
+        Aabb bounds;
+        bounds.left = end.x;
+        bounds.top = end.y;
+        bounds.right = end.x + bullet.width;
+        bounds.bottom = end.y + bullet.height;
+        const Bullet::Sweep sweep = Bullet::Sweep::of(bounds, moved);
+        if (!sweep.crosses)
+            continue;
+        auto exact = [&](sf::Vector2f back) { return CollisionMask::overlap(bullet, end - back, target, targetAt); };
+        // Whether the boxes, grown by 'grow', overlap at time t and the masks agree
+        auto hitAt = [&](float t, float grow) {
+            const sf::Vector2f back = moved * (1.f - t);
+            return bounds.left - back.x - grow < targetBounds.right && targetBounds.left < bounds.right - back.x + grow &&
+                bounds.top - back.y - grow < targetBounds.bottom && targetBounds.top < bounds.bottom - back.y + grow && exact(back);
+        };
+        const float speed = std::max(std::abs(moved.x), std::abs(moved.y));
+        const int samples = static_cast<int>(std::ceil(speed * 32.f));
+        float sampled = -1.f;
+        for (int k = 1; k <= samples && sampled < 0.f; ++k)
+            if (hitAt(static_cast<float>(k) / samples, 0.f))
+                sampled = static_cast<float>(k) / samples;
+        const float t = sweep.timeOfImpact(targetBounds, exact);
+        moves++;
+        hits += t >= 0.f;
+        if ((sampled >= 0.f && (t < 0.f || t > sampled + 1.f / speed)) || (t >= 0.f && !hitAt(t, slack)))
+            mismatches++;
+    }
+    std::cout << "Time of impact: " << moves << " fast or diagonal moves, " << hits << " hits, " << mismatches << " mismatched"
+        << (mismatches ? " MISMATCH" : "") << std::endl;
+    return mismatches == 0;
+}
+
+// The part of a convex polygon on one side of the line x = at (or y = at)
+std::vector<sf::Vector2f> clipPolygon(const std::vector<sf::Vector2f>& polygon, bool onY, float at, bool keepAbove) {
+    std::vector<sf::Vector2f> out;
+    for (size_t i = 0; i < polygon.size(); ++i) {
+        const sf::Vector2f a = polygon[i], b = polygon[(i + 1) % polygon.size()];
+        const float va = onY ? a.y : a.x, vb = onY ? b.y : b.x;
+        const bool keepA = keepAbove ? va >= at : va <= at, keepB = keepAbove ? vb >= at : vb <= at;
+        if (keepA)
+            out.push_back(a);
+        if (keepA != keepB)
+            out.push_back(a + (b - a) * ((at - va) / (vb - va)));
+    }
+    return out;
+}
+
+// Measured from its first corner, so slivers far from the origin do not cancel out
+float polygonArea(const std::vector<sf::Vector2f>& polygon) {
+    float twice = 0.f;
+    for (size_t i = 1; i + 1 < polygon.size(); ++i) {
+        const sf::Vector2f a = polygon[i] - polygon[0], b = polygon[i + 1] - polygon[0];
+        twice += a.x * b.y - b.x * a.y;
+    }
+    return std::abs(twice) * 0.5f;
+}
+
+// Random oriented boxes against random boxes: the separating axis test must
+// agree with clipping the turned box to the other one and measuring what is
+// left. Pairs that share less than 1/16 px^2 are too close to call in floats
+// and are only counted.
+bool runObbCheck() {
+    GameRandom rng;
+    rng.seed(46);
+    const int cases = 300000;
+    int hits = 0, touching = 0, mismatches = 0;
+    for (int c = 0; c < cases; ++c) {
+        Aabb upright;
+        upright.left = rng.nextFloat(0.f, 100.f);
+        upright.top = rng.nextFloat(0.f, 100.f);
+        upright.right = upright.left + rng.nextFloat(1.f, 30.f);
+        upright.bottom = upright.top + rng.nextFloat(1.f, 30.f);
+        const float angle = rng.nextFloat(0.f, 6.2831853f);
+        const Obb obb = Obb::of(upright, sf::Vector2f(std::cos(angle), std::sin(angle)) * rng.nextFloat(0.1f, 50.f));
+        Aabb box;
+        box.left = rng.nextFloat(-20.f, 120.f);
+        box.top = rng.nextFloat(-20.f, 120.f);
+        box.right = box.left + rng.nextFloat(1.f, 50.f);
+        box.bottom = box.top + rng.nextFloat(1.f, 50.f);
+        const sf::Vector2f x = obb.axisX * obb.half.x, y = obb.axisY * obb.half.y;
+        std::vector<sf::Vector2f> polygon = { obb.center - x - y, obb.center + x - y, obb.center + x + y, obb.center - x + y };
+        polygon = clipPolygon(polygon, false, box.left, true);
+        polygon = clipPolygon(polygon, false, box.right, false);
+        polygon = clipPolygon(polygon, true, box.top, true);
+        polygon = clipPolygon(polygon, true, box.bottom, false);
+        const float area = polygon.size() >= 3 ? polygonArea(polygon) : 0.f;
+        if (area > 0.f && area < 1.f / 16.f) {
+            touching++;
+            continue;
+        }
+        const bool intersects = obb.intersects(box);
+        hits += intersects;
+        if (intersects != (area > 0.f))
+            mismatches++;
+    }
+    std::cout << "Oriented boxes: " << cases << " pairs, " << hits << " overlapping, " << touching << " touching, " << mismatches << " mismatched"
+        << (mismatches ? " MISMATCH" : "") << std::endl;
+    return mismatches == 0;
+}
+
+// Bullet masks turned to random headings against upright targets, through the
+// same CollisionMasks lookups as the game. Heading straight down must give the
+// upright answer; the three quarter turns must give the upright answer for a
+// copy of the mask rotated pixel by pixel; and no heading may hit where the
+// separating axis test rules a hit out.
+bool runTurnedMaskCheck() {
+    GameRandom rng;
+    rng.seed(146);
+    std::vector<CollisionMask> shapes;
+    std::vector<sf::Texture> textures(96);
+    CollisionMasks masks;
+    for (size_t i = 0; i < textures.size(); ++i) {
+        // Bullets first, with an even width - height so a quarter turn keeps whole-pixel corners
+        const bool bullet = i < 64;
+        const int width = bullet ? 3 + rng.nextInt(10) : 10 + rng.nextInt(80);
+        const int height = bullet ? 2 + width % 2 + rng.nextInt(10) * 2 : 10 + rng.nextInt(80);
+        shapes.push_back(randomMask(rng, width, height, 1 + rng.nextInt(2)));
+        sf::Image image;
+        image.create(width, height, sf::Color::Transparent);
+        for (int y = 0; y < height; ++y)
+            for (int x = 0; x < width; ++x)
+                if (shapes[i].solid(x, y))
+                    image.setPixel(x, y, sf::Color::White);
+        textures[i].loadFromImage(image);
+        masks.add(textures[i]);
+    }
+    const int cases = 200000;
+    int hits = 0, mismatches = 0;
+    for (int c = 0; c < cases; ++c) {
+        const size_t b = rng.nextInt(64), t = 64 + rng.nextInt(32);
+        const CollisionMask& mask = shapes[b];
+        sf::Sprite bullet(textures[b]), target(textures[t]);
+        target.setPosition(static_cast<float>(rng.nextInt(50)), static_cast<float>(rng.nextInt(50)));
+        bullet.setPosition(static_cast<float>(rng.nextInt(120) - 20), static_cast<float>(rng.nextInt(120) - 20));
+        const Aabb box = Aabb::of(bullet), targetBox = Aabb::of(target);
+        const int turn = c % 5;
+        bool expected, got;
+        if (turn == 0) {
+            got = masks.overlap(Obb::of(box, sf::Vector2f(0.f, 1.f)), bullet, target);
+            expected = masks.overlap(bullet, sf::Vector2f(), target);
+        }
+        else if (turn <= 3) {
+            // Headings +x, -y and -x, and where each sends mask pixel (x, y)
+            static const sf::Vector2f headings[3] = { sf::Vector2f(1.f, 0.f), sf::Vector2f(0.f, -1.f), sf::Vector2f(-1.f, 0.f) };
+            got = masks.overlap(Obb::of(box, headings[turn - 1]), bullet, target);
+            const int w = mask.width, h = mask.height;
+            const bool half = turn != 2;
+            CollisionMask rotated = blankMask(half ? h : w, half ? w : h);
+            for (int y = 0; y < h; ++y) {
+                for (int x = 0; x < w; ++x) {
+                    if (!mask.solid(x, y))
+                        continue;
+                    const int rx = turn == 1 ? y : turn == 2 ? w - 1 - x : h - 1 - y;
+                    const int ry = turn == 1 ? w - 1 - x : turn == 2 ? h - 1 - y : x;
+                    rotated.rows[ry * rotated.words + rx / 64] |= sf::Uint64(1) << (rx % 64);
+                }
+            }
+            const sf::Vector2f corner = bullet.getPosition() + (half ? sf::Vector2f((w - h) / 2.f, (h - w) / 2.f) : sf::Vector2f());
+            expected = CollisionMask::overlap(rotated, corner, shapes[t], target.getPosition());
+        }
+        else {
+            const float angle = rng.nextFloat(0.f, 6.2831853f);
+            bullet.move(rng.nextFloat(0.f, 1.f), rng.nextFloat(0.f, 1.f));
+            const Obb collider = Obb::of(Aabb::of(bullet), sf::Vector2f(std::cos(angle), std::sin(angle)));
+            got = masks.overlap(collider, bullet, target);
+            expected = got && collider.intersects(targetBox);
+        }
+        hits += got;
+        if (got != expected)
+            mismatches++;
+    }
+    std::cout << "Turned masks: " << cases << " pairs, " << hits << " overlapping, " << mismatches << " mismatched"
+        << (mismatches ? " MISMATCH" : "") << std::endl;
+    return mismatches == 0;
+}
+
+// --- Main Entry Point ---
+// Usage: "Space Invaders.exe" [--record <file> | --replay <file> [--seek <seconds>] [--headless [--check]]] [--speed <x>] [--fixed-point]
+//                             [--broadphase grid|sweep|quadtree|auto]
+//        "Space Invaders.exe" --bench | --check
+int main(int argc, char* argv[]) {
+    LaunchOptions options;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if ((arg == "--record" || arg == "--replay") && i + 1 < argc) {
+            options.mode = (arg == "--record") ? LaunchOptions::RECORD : LaunchOptions::REPLAY;
+            options.replayFile = argv[++i];
+        }
+        else if (arg == "--seek" && i + 1 < argc) {
+            options.seekSeconds = static_cast<float>(std::atof(argv[++i]));
+        }
+        else if (arg == "--speed" && i + 1 < argc) {
+            options.timeScale = static_cast<float>(std::atof(argv[++i]));
+        }
+        else if (arg == "--fixed-point") {
+            options.fixedPoint = true;
+        }
+        else if (arg == "--headless") {
+            options.headless = true;
+        }
+        else if (arg == "--broadphase" && i + 1 < argc) {
+            std::string name = argv[++i];
+            if (name == "grid")
+                options.broadphase = LaunchOptions::GRID;
+            else if (name == "sweep")
+                options.broadphase = LaunchOptions::SORT_AND_SWEEP;
+            else if (name == "quadtree")
+                options.broadphase = LaunchOptions::QUADTREE;
+            else if (name != "auto") {
+                std::cerr << "Unknown broadphase: " << name << " (grid, sweep, quadtree or auto)" << std::endl;
+                return 1;
+            }
+        }
+        else if (arg == "--check") {
+            options.check = true;
+        }
+        else if (arg == "--bench") {
+            runOverlapBenchmark();
+            runClusterBenchmark();
+            runSpatialQueryBenchmark();
+            return 0;
+        }
+        else {
+            std::cerr << "Unknown argument: " << arg << std::endl;
+            return 1;
+        }
+    }
+    if (options.check && options.mode != LaunchOptions::REPLAY) {
+        bool passed = runJobSystemCheck();
+        passed = runSweepCheck() && passed;
+        passed = runMaskCheck() && passed;
+        passed = runTimeOfImpactCheck() && passed;
+        passed = runObbCheck() && passed;
+        passed = runTurnedMaskCheck() && passed;
+        return passed ? 0 : 1;
+    }
+    if (options.check && !options.headless) {
+        std::cerr << "--check with a replay needs --headless" << std::endl;
+        return 1;
+    }
+    if (options.headless && options.mode != LaunchOptions::REPLAY) {
+        std::cerr << "--headless needs --replay <file>" << std::endl;
+        return 1;
+    }
+    SpaceInvadersGame game(options);
+    game.run();
+    return 0;
 }
\ No newline at end of file